@@ -13,7 +13,7 @@ int SLICE = 2*SCALE;
 int NWIND = 250;
 int NWATER = 250;
 
-#define POOLSIZE 10000000
+int POOLSIZE = 10000000;
 int SEED;
 
 #include "source/include/vertexpool.h"
@@ -22,6 +22,9 @@ int SEED;
 #include "source/layermap.h"
 #include "source/particle/water.h"
 #include "source/particle/wind.h"
+#include "source/pipes.h"
+#include "source/lakes.h"
+#include "source/erosion.h"
 
 #include "source/io.h"
 
@@ -39,11 +42,27 @@ int main( int argc, char* args[] ) {
 	else SEED = rand();
 	cout<<"SEED: "<<SEED<<endl;
 	srand(SEED);														//Re-Seed
+	dist::seed(SEED);
 
 	if(parse::option.contains("soil"))
 		loadsoil(parse::option["soil"]);
 	else loadsoil();
 
+	#ifdef _OPENMP
+	if(parse::option.contains("threads"))
+		omp_set_num_threads(stoi(parse::option["threads"]));
+	#endif
+
+	if(parse::option.contains("rain")){											//Water Spawn Density
+		string rain = parse::option["rain"];
+		if(rain == "altitude") erosion::RAIN = erosion::ALTITUDE;
+		else if(rain == "frequency") erosion::RAIN = erosion::FREQUENCY;
+		else if(rain != "uniform"){
+			erosion::rainfall = loadrainfall(rain);
+			erosion::RAIN = erosion::RAINFALL;
+		}
+	}
+
 	WaterParticle::init();
 	WindParticle::init();
 
@@ -67,6 +86,9 @@ int main( int argc, char* args[] ) {
 	bool dowatercycles = true;
 	bool paused = true;
 
+	int compactevery = 0;										//Compaction Interval (0: Never)
+	int cycle = 0;
+
 	glDisable(GL_CULL_FACE);
 
 	Tiny::event.handler = [&](){
@@ -82,6 +104,14 @@ int main( int argc, char* args[] ) {
 	Vertexpool<Vertex> vertexpool(SIZEX*SIZEY, 1);
 	Layermap map(SEED, glm::ivec2(SIZEX, SIZEY), vertexpool);
 
+	float lakefill = -1.0f;													//Fill (1) or Drain (0) Basins on Seed
+	if(parse::option.contains("lakes"))
+		lakefill = stof(parse::option["lakes"]);
+	if(lakefill >= 0.0f){
+		lakes::fill(map, lakefill);
+		map.flush(vertexpool);
+	}
+
 	//Particle Visualization Textures
 	Texture watertexture(image::make([&](ivec2 i){
 		float wf = WaterParticle::frequency[i.y*SIZEX+i.x];
@@ -93,8 +123,17 @@ int main( int argc, char* args[] ) {
 		return vec4(wf, wf, wf, 1);
 	}, ivec2(SIZEX, SIZEY)));
 
+	//Texture Buffers, Only Rebuilt while Visible
+	vector<uint32_t> watertexels(SIZEX*SIZEY);
+	vector<uint32_t> windtexels(SIZEX*SIZEY);
+	bool showwatertexture = false;
+	bool showwindtexture = false;
+
 	Tiny::view.interface = [&](){
 
+		showwatertexture = false;
+		showwindtexture = false;
+
 //		ImGui::ShowDemoWindow();
 
 		ImGui::SetNextWindowSize(ImVec2(400, 300), ImGuiCond_Once);
@@ -110,12 +149,35 @@ int main( int argc, char* args[] ) {
 				ImGui::DragInt("Seed", &SEED, 1, 0, 100000000);
 				if(ImGui::Button("Re-Seed")){
 					map.initialize(SEED, ivec2(SIZEX, SIZEY));
+					erosion::reset();
+					if(lakefill >= 0.0f)
+						lakes::fill(map, lakefill);
 					map.meshpool(vertexpool);
+					cycle = 0;
 				}
 
-				ImGui::Text("Memory Pool Usage: %f%%", 100.0*((double)POOLSIZE-(double)map.pool.free.size())/(double)POOLSIZE);
+				if(ImGui::Button("Fill Lakes")){
+					lakes::fill(map, 1.0);
+					map.flush(vertexpool);
+				}
+				ImGui::SameLine();
+				if(ImGui::Button("Drain Lakes")){
+					lakes::fill(map, 0.0);
+					map.flush(vertexpool);
+				}
+
+				ImGui::Text("Memory Pool Usage: %f%%", 100.0*((double)map.pool.size-(double)map.pool.available())/(double)map.pool.size);
+				ImGui::Text("Memory Pool Size: %d (Peak Usage %d)", map.pool.size, map.pool.peak);
 
-				ImGui::SliderInt("World Scale", &SCALE, 15, 250);
+				ImGui::DragInt("Compact Every N Cycles", &compactevery, 1, 0, 10000);
+				if(ImGui::Button("Compact Layermap")){
+					int reclaimed = map.compact(1E-6, true);
+					cout<<"Compacted Layermap: "<<reclaimed<<" Elements Reclaimed"<<endl;
+				}
+
+				if(ImGui::SliderInt("World Scale", &SCALE, 15, 250)){
+					map.invalidate();						//Normals Depend on the Scale
+				}
 				if(ImGui::SliderInt("World Slice", &SLICE, 0, 2*SCALE)){
 					map.update(vertexpool);
 				}
@@ -128,9 +190,19 @@ int main( int argc, char* args[] ) {
 				if(ImGui::TreeNode("Hydraulic Erosion")){
 					ImGui::Checkbox("Do Water Cycles?", &dowatercycles);
 					ImGui::DragInt("Particles per Frame", &NWATER, 1, 0, 2000);
+					ImGui::Combo("Spawn Density", (int*)&erosion::RAIN, "Uniform\0Rainfall\0Altitude\0Frequency\0\0");
+					ImGui::DragInt("Step Budget (0: None)", &erosion::BUDGET, 100, 0, 1000000);
+					ImGui::DragInt("Pending Cycles (Budgeted)", &erosion::BACKLOG, 1, 0, 100);
+					ImGui::Checkbox("Pipes Solver for Standing Water?", &pipes::ENABLED);
+					ImGui::DragInt("Pipes Steps per Frame", &pipes::STEPS, 1, 1, 256);
+					erosion::Counters& c = erosion::counters;
+					ImGui::Text("Steps per Particle: %.1f, Cascade Depth: %d", c.perparticle(), c.depth);
+					ImGui::Text("Spills: %zu, Pending: %zu, Deposited: %zu", c.spills, c.pending, c.deposited);
+					ImGui::Text("Seeping Columns: %zu", c.seeping);
 					ImGui::Checkbox("Overlay Map?", &scene::wateroverlay);
 					ImGui::Text("Frequency Texture: ");
 					ImGui::Image((void*)(intptr_t)watertexture.texture, ImVec2(SIZEX, SIZEY));
+					showwatertexture = true;
 					ImGui::TreePop();
 				}
 
@@ -139,6 +211,7 @@ int main( int argc, char* args[] ) {
 					ImGui::DragInt("Particles per Frame", &NWIND, 1, 0, 2000);
 					ImGui::Text("Frequency Texture: ");
 					ImGui::Image((void*)(intptr_t)windtexture.texture, ImVec2(SIZEX, SIZEY));
+					showwindtexture = true;
 					ImGui::TreePop();
 				}
 
@@ -164,29 +237,37 @@ int main( int argc, char* args[] ) {
 			 	}
 
 				//Visualize the Data from the Selected Soil
-				if(ImGui::ColorEdit3("Color", &soils[selected].color[0]))
+				bool edited = false;		//Any Parameter Changed this Frame
+				if(ImGui::ColorEdit3("Color", &soils[selected].color[0])){
 					map.update(vertexpool);
+					edited = true;
+				}
 
-				ImGui::DragFloat("Density", &soils[selected].density, 0.0001f, 0.0f, 1.0f);
+				edited |= ImGui::DragFloat("Density", &soils[selected].density, 0.0001f, 0.0f, 1.0f);
 
 				if(ImGui::TreeNode("Hydraulic Erosion")){
-					ImGui::DragFloat("Water Solubility", &soils[selected].solubility, 0.0001f, 0.0f, 1.0f);
-					ImGui::DragFloat("Equilibriation Rate", &soils[selected].equrate, 0.0001f, 0.0f, 1.0f);
-					ImGui::DragFloat("Surface Friction", &soils[selected].friction, 0.0001f, 0.0f, 1.0f);
-					ImGui::DragFloat("Erosion Rate", &soils[selected].erosionrate, 0.0001f, 0.0f, 1.0f);
+					edited |= ImGui::DragFloat("Water Solubility", &soils[selected].solubility, 0.0001f, 0.0f, 1.0f);
+					edited |= ImGui::DragFloat("Equilibriation Rate", &soils[selected].equrate, 0.0001f, 0.0f, 1.0f);
+					edited |= ImGui::DragFloat("Surface Friction", &soils[selected].friction, 0.0001f, 0.0f, 1.0f);
+					edited |= ImGui::DragFloat("Erosion Rate", &soils[selected].erosionrate, 0.0001f, 0.0f, 1.0f);
 					ImGui::TreePop();
 				}
 
 				if(ImGui::TreeNode("Wind Erosion")){
-					ImGui::DragFloat("Suspension Rate", &soils[selected].suspension, 0.0001f, 0.0f, 1.0f);
+					edited |= ImGui::DragFloat("Suspension Rate", &soils[selected].suspension, 0.0001f, 0.0f, 1.0f);
 					ImGui::TreePop();
 				}
 				if(ImGui::TreeNode("Sediment Cascading")){
-					ImGui::DragFloat("Max. Pile Height", &soils[selected].maxdiff, 0.0001f, 0.0f, 1.0f);
-					ImGui::DragFloat("Settling Rate", &soils[selected].settling, 0.0001f, 0.0f, 1.0f);
+					edited |= ImGui::DragFloat("Max. Pile Height", &soils[selected].maxdiff, 0.0001f, 0.0f, 1.0f);
+					edited |= ImGui::DragFloat("Settling Rate", &soils[selected].settling, 0.0001f, 0.0f, 1.0f);
 					ImGui::TreePop();
 				}
 
+				#ifndef SOILMACHINE_FROZEN
+				if(edited)
+					surf.build();		//Mirror Edits into the Hot Parameter Table
+				#endif
+
 				ImGui::EndTabItem();
 			}
 
@@ -285,45 +366,36 @@ int main( int argc, char* args[] ) {
 		if(paused) return;
 
 		if(dowatercycles)
-		for(int i = 0; i < NWATER; i++){
-
-			WaterParticle particle(map);
-
-			while(true){
-				while(particle.move(map, vertexpool) && particle.interact(map, vertexpool));
-				if(!particle.flood(map, vertexpool))
-					break;
-			}
-
-		}
+		erosion::water(map, NWATER, cycle);
 
 		if(dowatercycles)
-		WaterParticle::seep(map, vertexpool);
+		erosion::seep(map);
 
 		if(dowindcycles)
-		for(int i = 0; i < NWIND; i++){
-			WindParticle particle(map);
-			while(particle.move(map, vertexpool) && particle.interact(map, vertexpool));
-		}
+		erosion::wind(map, NWIND, cycle);
+
+		if(compactevery > 0 && (cycle+1)%compactevery == 0)
+			map.compact(1E-6, true);
+		cycle++;
+
+		//Update Modified Vertices
+		map.flush(vertexpool);
 
 		if(lbmw::updatewind)
 			lbmw::update();
 
 		//Update Raw Textures
 		if(dowatercycles){
-			WaterParticle::mapfrequency(map);
-			watertexture.raw(image::make([&](ivec2 i){
-				float wf = WaterParticle::frequency[i.y*SIZEX+i.x];
-				return vec4(wf, wf, wf, 1);
-			}, ivec2(SIZEX, SIZEY)));
-			WaterParticle::resetfrequency(map);
+			if(showwatertexture || scene::wateroverlay){
+				WaterParticle::mapfrequency(map, watertexels.data());
+				watertexture.raw(SDL_CreateRGBSurfaceWithFormatFrom(watertexels.data(), SIZEX, SIZEY, 32, 4*SIZEX, SDL_PIXELFORMAT_ABGR8888));
+			}
+			else WaterParticle::mapfrequency(map);
 		}
 
-		if(dowindcycles){
-			windtexture.raw(image::make([&](ivec2 i){
-				float wf = WindParticle::frequency[i.y*SIZEX+i.x];
-				return vec4(wf, wf, wf, 1);
-			}, ivec2(SIZEX, SIZEY)));
+		if(dowindcycles && showwindtexture){
+			WindParticle::maptexture(map, windtexels.data());
+			windtexture.raw(SDL_CreateRGBSurfaceWithFormatFrom(windtexels.data(), SIZEX, SIZEY, 32, 4*SIZEX, SDL_PIXELFORMAT_ABGR8888));
 		}
 
 	});
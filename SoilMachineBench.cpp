@@ -0,0 +1,272 @@
+#define SOILMACHINE_HEADLESS
+
+#include "source/include/headless.h"
+
+int SIZEX = 256;
+int SIZEY = 256;
+int SCALE = 80;
+int SLICE = 2*SCALE;
+int NWIND = 250;
+int NWATER = 250;
+
+int POOLSIZE = 10000000;
+int SEED = 0;
+
+#include "source/layermap.h"
+#include "source/particle/water.h"
+#include "source/io.h"
+
+/*
+================================================================================
+                    Micro-Benchmarks for Layermap Queries
+================================================================================
+*/
+
+namespace bench {
+
+using clk = chrono::high_resolution_clock;
+
+//Time a Kernel over N Iterations, Print Throughput
+template<typename F>
+void measure(string name, const size_t N, F kernel){
+  auto start = clk::now();
+  double sink = kernel();
+  auto stop = clk::now();
+  double s = chrono::duration_cast<chrono::microseconds>(stop - start).count()*1E-6;
+  cout<<"  "<<name<<": "<<N/s*1E-6<<" M/s ("<<s*1E3<<" ms, "<<sink<<")"<<endl;
+}
+
+void queries(ivec2 dim){
+
+  #ifdef SOILMACHINE_COLUMNS
+  cout<<"Layermap Queries ("<<dim.x<<"x"<<dim.y<<", Columns)"<<endl;
+  #else
+  cout<<"Layermap Queries ("<<dim.x<<"x"<<dim.y<<", Linked-List)"<<endl;
+  #endif
+
+  Layermap map(SEED, dim);
+
+  const size_t N = 1 << 24;
+  vector<ivec2> random(N);
+  for(auto& p: random)
+    p = ivec2(rand()%dim.x, rand()%dim.y);
+
+  //Churn: Fragment the Storage like a Long Erosion Run
+  const size_t C = (parse::option.contains("churn")) ? stoi(parse::option["churn"]) : dim.x*dim.y;
+  for(size_t k = 0; k < C; k++){
+    map.add(ivec2(rand()%dim.x, rand()%dim.y), map.pool.get(0.01, soilmap["Air"]));
+    map.remove(ivec2(rand()%dim.x, rand()%dim.y), 0.01);
+  }
+
+  measure("height (sweep)", dim.x*dim.y, [&](){
+    double h = 0.0;
+    for(int i = 0; i < dim.x; i++)
+    for(int j = 0; j < dim.y; j++)
+      h += map.height(ivec2(i, j));
+    return h;
+  });
+
+  measure("height (random)", N, [&](){
+    double h = 0.0;
+    for(auto& p: random)
+      h += map.height(p);
+    return h;
+  });
+
+  measure("surface (random)", N, [&](){
+    double s = 0.0;
+    for(auto& p: random)
+      s += map.surface(p);
+    return s;
+  });
+
+  measure("top (random)", N, [&](){
+    double s = 0.0;
+    for(auto& p: random)
+      if(map.top(p) != NULL)
+        s += map.top(p)->size;
+    return s;
+  });
+
+  measure("column walk (random)", N, [&](){
+    double s = 0.0;
+    for(auto& p: random)
+    for(sec* T = map.top(p); T != NULL; T = T->prev)
+      s += T->size;
+    return s;
+  });
+
+}
+
+void compaction(ivec2 dim){
+
+  cout<<"Layermap Compaction ("<<dim.x<<"x"<<dim.y<<")"<<endl;
+
+  SIZEX = dim.x;
+  SIZEY = dim.y;
+  WaterParticle::init();
+
+  Layermap map(SEED, dim);
+  Vertexpool<Vertex> vertexpool(dim.x*dim.y, 1);
+  map.meshpool(vertexpool);
+
+  //Fragment: Many Thin, Alternating Runs
+  const size_t C = (parse::option.contains("churn")) ? stoi(parse::option["churn"]) : 8*dim.x*dim.y;
+  for(size_t k = 0; k < C; k++){
+    SurfType type = 1 + rand()%(soils.size()-1);
+    double size = 1E-7*pow(1E4, (double)rand()/RAND_MAX);
+    map.add(ivec2(rand()%dim.x, rand()%dim.y), map.pool.get(size, type));
+  }
+
+  const size_t N = dim.x*dim.y;
+  const auto walk = [&](){
+    double s = 0.0;
+    for(int i = 0; i < dim.x; i++)
+    for(int j = 0; j < dim.y; j++)
+    for(sec* T = map.top(ivec2(i, j)); T != NULL; T = T->prev)
+      s += T->size*T->saturation;
+    return s;
+  };
+
+  cout<<" Before ("<<map.pool.size - map.pool.available()<<" Elements)"<<endl;
+  measure("column walk", N, walk);
+  measure("update", N, [&](){ map.update(vertexpool); return 0.0; });
+  measure("seep", N, [&](){ WaterParticle::seep(map); return 0.0; });
+
+  auto start = clk::now();
+  int reclaimed = map.compact(1E-6, true);
+  auto stop = clk::now();
+  cout<<" Compacted: "<<reclaimed<<" Elements Reclaimed ("<<chrono::duration_cast<chrono::milliseconds>(stop - start).count()<<" ms)"<<endl;
+
+  cout<<" After ("<<map.pool.size - map.pool.available()<<" Elements)"<<endl;
+  measure("column walk", N, walk);
+  measure("update", N, [&](){ map.update(vertexpool); return 0.0; });
+  measure("seep", N, [&](){ WaterParticle::seep(map); return 0.0; });
+
+}
+
+void packets(ivec2 dim){
+
+  cout<<"Water Particle Move ("<<dim.x<<"x"<<dim.y<<", Packets of "<<WaterParticle::PACKET<<")"<<endl;
+
+  SIZEX = dim.x;
+  SIZEY = dim.y;
+  WaterParticle::init();
+
+  Layermap map(SEED, dim);
+
+  const size_t N = 1 << 20;
+  vector<WaterParticle> spawned;
+  for(size_t i = 0; i < N; i++)
+    spawned.emplace_back(map, 0, i);
+
+  for(int i = 0; i < dim.x; i++)          //Warm the Normal Field
+  for(int j = 0; j < dim.y; j++)
+    map.normal(ivec2(i, j));
+
+  const int steps = 8;
+  vector<WaterParticle> particles(spawned);
+  measure("move (scalar)", N*steps, [&](){
+    double s = 0.0;
+    for(auto& p: particles)
+    for(int k = 0; k < steps && p.move(map); k++)
+      s += p.pos.x;
+    return s;
+  });
+
+  particles = vector<WaterParticle>(spawned);
+  measure("move (packet)", N*steps, [&](){
+    double s = 0.0;
+    WaterParticle::Packet P;
+    for(size_t i = 0; i < N; i += WaterParticle::PACKET){
+      P.n = std::min((size_t)WaterParticle::PACKET, N-i);
+      for(int k = 0; k < P.n; k++)
+        P.particle[k] = &particles[i+k];
+      for(int k = 0; k < steps && P.n > 0; k++){
+        WaterParticle::move(map, P);
+        int n = 0;                      //Drop Stopped Lanes
+        for(int l = 0; l < P.n; l++)
+        if(P.moved[l]){
+          s += P.particle[l]->pos.x;
+          P.particle[n++] = P.particle[l];
+        }
+        P.n = n;
+      }
+    }
+    return s;
+  });
+
+}
+
+void params(ivec2 dim){
+
+  cout<<"Surface Parameter Lookup ("<<dim.x<<"x"<<dim.y<<", "<<soils.size()<<" Types)"<<endl;
+
+  Layermap map(SEED, dim);
+
+  //Surface Types under Random Particle Steps
+  const size_t N = 1 << 24;
+  vector<SurfType> types(N);
+  for(auto& t: types)
+    t = map.surface(ivec2(rand()%dim.x, rand()%dim.y));
+
+  //Fields Read by one Water Particle Step (move, interact, cascade)
+  measure("SurfParam (copy)", N, [&](){
+    double s = 0.0;
+    for(auto& t: types){
+      SurfParam param = soils[t];
+      SurfParam cparam = soils[param.transports];
+      s += param.friction + param.solubility + param.equrate;
+      s += cparam.erosionrate + cparam.maxdiff + cparam.settling;
+    }
+    return s;
+  });
+
+  measure("SurfTable (reference)", N, [&](){
+    double s = 0.0;
+    for(auto& t: types){
+      const SurfType c = surf.transports[t];
+      s += surf.friction[t] + surf.solubility[t] + surf.equrate[t];
+      s += surf.erosionrate[c] + surf.maxdiff[c] + surf.settling[c];
+    }
+    return s;
+  });
+
+}
+
+}
+
+int main( int argc, char* args[] ) {
+
+	parse::get(argc, args);
+
+	if(parse::option.contains("SEED"))
+		SEED = stoi(parse::option["SEED"]);
+	srand(SEED);
+
+	if(parse::option.contains("soil"))
+		loadsoil(parse::option["soil"]);
+	else loadsoil();
+
+	vector<int> sizes = {1024, 4096};
+	if(parse::option.contains("size"))
+		sizes = { stoi(parse::option["size"]) };
+
+	string run = "all";
+	if(parse::option.contains("run"))
+		run = parse::option["run"];
+
+	for(auto& s: sizes){
+		if(run == "all" || run == "queries")
+			bench::queries(ivec2(s, s));
+		if(run == "all" || run == "compaction")
+			bench::compaction(ivec2(s, s));
+		if(run == "all" || run == "packets")
+			bench::packets(ivec2(s, s));
+		if(run == "all" || run == "params")
+			bench::params(ivec2(s, s));
+	}
+
+	return 0;
+
+}
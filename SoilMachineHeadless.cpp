@@ -0,0 +1,159 @@
+#define SOILMACHINE_HEADLESS
+
+#include "source/include/headless.h"
+
+int SIZEX = 256;
+int SIZEY = 256;
+int SCALE = 80;
+int SLICE = 2*SCALE;
+int NWIND = 250;
+int NWATER = 250;
+
+int POOLSIZE = 10000000;
+int SEED;
+
+#include "source/layermap.h"
+#include "source/particle/water.h"
+#include "source/particle/wind.h"
+#include "source/pipes.h"
+#include "source/lakes.h"
+#include "source/erosion.h"
+
+#include "source/io.h"
+
+int main( int argc, char* args[] ) {
+
+	cout<<"Launching SoilMachine V1.1 (Headless)"<<endl;
+
+	parse::get(argc, args);
+
+	srand(time(NULL));
+	if(parse::option.contains("SEED"))
+		SEED = stoi(parse::option["SEED"]);
+	else SEED = rand();
+	cout<<"SEED: "<<SEED<<endl;
+	srand(SEED);														//Re-Seed
+	dist::seed(SEED);
+
+	if(parse::option.contains("soil"))
+		loadsoil(parse::option["soil"]);
+	else loadsoil();
+
+	if(parse::option.contains("freeze")){							//Generate Frozen Profile
+		string soil = (parse::option.contains("soil")) ? parse::option["soil"] : "soil/default.soil";
+		freezesoil(parse::option["freeze"], soil);
+		return 0;
+	}
+
+	int NCYCLES = 1000;
+	if(parse::option.contains("n"))
+		NCYCLES = stoi(parse::option["n"]);
+
+	int NCOMPACT = 0;																//Compaction Interval (0: Never)
+	if(parse::option.contains("compact"))
+		NCOMPACT = stoi(parse::option["compact"]);
+
+	#ifdef _OPENMP
+	if(parse::option.contains("threads"))
+		omp_set_num_threads(stoi(parse::option["threads"]));
+	cout<<"Threads: "<<omp_get_max_threads()<<endl;
+	#endif
+
+	if(parse::option.contains("tile"))											//Erosion Tile Width
+		erosion::TILESIZE = stoi(parse::option["tile"]);
+	erosion::PACKETS = parse::flag.contains("packets");
+	pipes::ENABLED = parse::flag.contains("pipes");
+	if(parse::option.contains("pipesteps"))
+		pipes::STEPS = stoi(parse::option["pipesteps"]);
+	if(parse::option.contains("budget"))											//Particle Steps per Cycle
+		erosion::BUDGET = stoi(parse::option["budget"]);
+	if(parse::option.contains("backlog"))											//Cycles a Particle may Stay Pending
+		erosion::BACKLOG = stoi(parse::option["backlog"]);
+
+	if(parse::option.contains("rain")){											//Water Spawn Density
+		string rain = parse::option["rain"];
+		if(rain == "altitude") erosion::RAIN = erosion::ALTITUDE;
+		else if(rain == "frequency") erosion::RAIN = erosion::FREQUENCY;
+		else if(rain != "uniform"){
+			erosion::rainfall = loadrainfall(rain);
+			erosion::RAIN = erosion::RAINFALL;
+		}
+	}
+
+	bool dowindcycles = !parse::flag.contains("nowind");
+	bool dowatercycles = !parse::flag.contains("nowater");
+
+	WaterParticle::init();
+	WindParticle::init();
+
+	//Define Layermap, Construct Vertexpool
+	Vertexpool<Vertex> vertexpool(SIZEX*SIZEY, 1);
+	Layermap map(SEED, glm::ivec2(SIZEX, SIZEY), vertexpool);
+
+	if(parse::option.contains("lakes"))											//Fill (1) or Drain (0) Basins
+		lakes::fill(map, stof(parse::option["lakes"]));
+
+	cout<<"Running "<<NCYCLES<<" Cycles"<<endl;
+	auto start = chrono::high_resolution_clock::now();
+
+	for(int n = 0; n < NCYCLES; n++){
+
+		if(dowatercycles)
+		erosion::water(map, NWATER, n);
+
+		if(dowatercycles)
+		erosion::seep(map);
+
+		if(dowindcycles)
+		erosion::wind(map, NWIND, n);
+
+		if(dowatercycles){
+			WaterParticle::mapfrequency(map);
+		}
+
+		if(NCOMPACT > 0 && (n+1)%NCOMPACT == 0){
+			int reclaimed = map.compact(1E-6, true);
+			cout<<"Compacted Layermap: "<<reclaimed<<" Elements Reclaimed"<<endl;
+		}
+
+		if((n+1)%100 == 0){
+			auto now = chrono::high_resolution_clock::now();
+			double ms = chrono::duration_cast<chrono::milliseconds>(now - start).count();
+			cout<<"Cycle "<<n+1<<" / "<<NCYCLES<<" ("<<ms/(n+1)<<" ms per Cycle)"<<endl;
+			if(dowatercycles){
+				erosion::Counters& c = erosion::counters;
+				cout<<"  Water: "<<c.spawned<<" Spawned, "<<c.carried<<" Carried, "<<c.spills<<" Spills, ";
+				cout<<c.perparticle()<<" Steps per Particle, Cascade Depth "<<c.depth<<", "<<c.pending<<" Pending, "<<c.deposited<<" Deposited, "<<c.seeping<<" Seeping Columns"<<endl;
+			}
+		}
+
+	}
+
+	auto stop = chrono::high_resolution_clock::now();
+	cout<<"Finished in "<<chrono::duration_cast<chrono::milliseconds>(stop - start).count()<<" ms"<<endl;
+	cout<<"Memory Pool: "<<map.pool.size<<" Elements (Peak Usage "<<map.pool.peak<<")"<<endl;
+
+	map.flush(vertexpool);
+
+	if(parse::option.contains("oc"))
+		exportcolor(map, vertexpool, parse::option["oc"]);
+	else exportcolor(map, vertexpool);
+
+	if(parse::option.contains("oh"))
+		exportheight(map, vertexpool, parse::option["oh"]);
+	else exportheight(map, vertexpool);
+
+	if(parse::option.contains("or"))
+		exportraw(map, parse::option["or"]);
+
+	if(parse::option.contains("compare")){
+		double tolerance = 0.5;
+		if(parse::option.contains("tolerance"))
+			tolerance = stod(parse::option["tolerance"]);
+		if(!compareraw(map, parse::option["compare"], tolerance))
+			return 1;
+	}
+
+	return 0;
+
+}
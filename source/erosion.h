@@ -0,0 +1,627 @@
+/*
+================================================================================
+              Spatially Partitioned (Parallel) Hydraulic Erosion
+================================================================================
+
+The map is split into square tiles, which are colored in a 2x2 checkerboard.
+A particle only ever modifies the map within a few cells of its position, so as
+long as tiles are wider than twice this reach, all tiles of one color can be
+processed concurrently without touching the same cells.
+
+Each tile owns a queue of particles. A particle is simulated until its position
+leaves the tile, at which point it is handed off to the queue of the tile it
+moved into and resumes there in a later phase. Spill particles spawned by the
+water cascade are queued in the tile that spawned them.
+
+Spawn positions are keyed by (SEED, cycle, index), phases run in color order
+and handoffs are merged in tile order, so the result only depends on the SEED,
+never on the number of threads.
+
+With a step budget, the particle steps of a cycle are bounded. Before every
+phase, the steps left are shared among the tiles of that phase by the length of
+their queues, so steps a tile does not use go to tiles with work in later
+phases. Particles still queued when the budget is spent, including spills of
+the seep pass, are kept pending and continue first in the next cycle. Once a
+particle waited BACKLOG cycles, its sediment is deposited where it stands and
+its water evaporates, so the backlog stays bounded. The budget only bounds the
+particle steps: the seep pass itself is not budgeted.
+
+Seeping runs in two phases: a column-local vertical percolation over all cells
+in parallel, then the lateral water cascade over the tiles of one color at a
+time. Its spill particles are queued in the tiles and run like new particles.
+
+Particles spawn uniformly by default. Otherwise, spawn cells are drawn from an
+alias table over a density map (rainfall texture, altitude or flow frequency),
+so that the particle budget is spent where water actually erodes.
+
+*/
+
+#include <optional>
+
+namespace erosion {
+
+int TILESIZE = 64;              //Tile Width (>= 2*REACH+1)
+const int REACH = 5;            //Maximum Distance of Map Access from a Particle
+const int MAXROUNDS = 16;       //Rounds of Phases before Serial Fallback
+bool PACKETS = false;           //Move Particles in SIMD Packets
+int BUDGET = 0;                 //Particle Steps per Cycle (0: Unlimited)
+int BACKLOG = 4;                //Cycles a Particle may Stay Pending (Budgeted)
+
+struct Counters {
+  size_t spawned = 0;           //New Particles
+  size_t carried = 0;           //Pending Particles from the Last Cycle
+  size_t spills = 0;            //Spill Particles from Cascades
+  size_t steps = 0;             //Particle Steps (Move or Flood)
+  size_t pending = 0;           //Particles Deferred to the Next Cycle
+  size_t deposited = 0;         //Pending Particles Deposited (Backlog Full)
+  int depth = 0;                //Deepest Cascade Recursion
+  size_t seeping = 0;           //Active Columns Seeped
+
+  double perparticle(){
+    const size_t n = spawned + carried + spills;
+    return (n == 0) ? 0.0 : (double)steps/n;
+  }
+};
+
+Counters counters;              //Counters of the Last Cycle
+
+struct Pending {
+  WaterParticle particle;
+  bool flooding = false;        //Particle Stopped, Resumes at Flood
+  int age = 0;                  //Cycles Spent Pending
+};
+
+struct Tile {
+  ivec2 min, max;               //Cell Range [min, max)
+  deque<Pending> queue;         //Particles to Simulate
+  vector<pair<int, Pending>> outbox;  //Particles Handed Off (Target Tile)
+
+  size_t budget = 0;            //Step Limit this Phase (Budgeted)
+  size_t steps = 0;             //Steps Taken this Cycle
+  size_t spills = 0;            //Spill Particles Queued this Cycle
+  int depth = 0;                //Deepest Cascade Recursion this Cycle
+
+  bool exhausted(){
+    return BUDGET > 0 && steps >= budget;
+  }
+};
+
+vector<Tile> tiles;
+ivec2 ntiles = ivec2(0);
+
+void partition(Layermap& map){
+
+  if(TILESIZE < 2*REACH+1)
+    TILESIZE = 2*REACH+1;
+
+  ntiles = (map.dim + TILESIZE - 1) / TILESIZE;
+  tiles = vector<Tile>(ntiles.x*ntiles.y);
+
+  for(int i = 0; i < ntiles.x; i++)
+  for(int j = 0; j < ntiles.y; j++){
+    Tile& tile = tiles[i*ntiles.y+j];
+    tile.min = ivec2(i, j)*TILESIZE;
+    tile.max = glm::min(tile.min + TILESIZE, map.dim);
+  }
+
+}
+
+//Drop Pending Particles and Fluxes of the Previous Map (Re-Initialization)
+void reset(){
+  tiles.clear();
+  counters = Counters();
+  pipes::reset();
+}
+
+int tileof(ivec2 pos){
+  return (pos.x/TILESIZE)*ntiles.y+(pos.y/TILESIZE);
+}
+
+int colorof(int t){
+  return 2*((t/ntiles.y)%2) + (t%ntiles.y)%2;
+}
+
+bool inside(Tile& tile, ivec2 pos){
+  return glm::all(glm::greaterThanEqual(pos, tile.min))
+      && glm::all(glm::lessThan(pos, tile.max));
+}
+
+//Flood a Stopped Particle or Hand it Off, True if it Resumes Stepping
+bool settle(Tile& tile, Pending& p, Layermap& map){
+
+  WaterParticle& particle = p.particle;
+  p.flooding = true;
+
+  if(particle.volume < particle.minvol)
+    return false;
+
+  if(!inside(tile, particle.pos)){
+    tile.outbox.push_back({tileof(particle.pos), p});
+    return false;
+  }
+
+  p.flooding = false;
+  tile.steps++;
+  return particle.flood(map);
+
+}
+
+//Simulate all Queued Particles of a Tile
+void process(Tile& tile, Layermap& map){
+
+  vector<WaterParticle> spawned;
+  WaterParticle::spawned = &spawned;
+  WaterParticle::maxdepth = 0;
+
+  while(!tile.queue.empty() && !tile.exhausted()){
+
+    Pending p = tile.queue.front();
+    tile.queue.pop_front();
+    WaterParticle& particle = p.particle;
+
+    do {
+
+      if(p.flooding)
+        continue;
+
+      //Step while Inside, Handoff when Leaving, Pause when Out of Budget
+      bool left = false, paused = false;
+      while(true){
+        if(!inside(tile, round(particle.pos))){
+          left = true;
+          break;
+        }
+        if(tile.exhausted()){
+          paused = true;
+          break;
+        }
+        tile.steps++;
+        if(!(particle.move(map) && particle.interact(map)))
+          break;
+      }
+
+      if(left){
+        tile.outbox.push_back({tileof(round(particle.pos)), p});
+        break;
+      }
+
+      if(paused){                 //Resumes Next Cycle
+        tile.queue.push_front(p);
+        break;
+      }
+
+    } while(settle(tile, p, map));
+
+    tile.spills += spawned.size();
+    for(auto& s: spawned)
+      tile.queue.push_back({s});
+    spawned.clear();
+
+  }
+
+  tile.depth = std::max(tile.depth, WaterParticle::maxdepth);
+  WaterParticle::spawned = NULL;
+
+}
+
+//Simulate all Queued Particles of a Tile, Moving them in Packets
+void packets(Tile& tile, Layermap& map){
+
+  vector<WaterParticle> spawned;
+  WaterParticle::spawned = &spawned;
+  WaterParticle::maxdepth = 0;
+
+  const int W = WaterParticle::PACKET;
+  WaterParticle::Packet P;
+  optional<Pending> lane[W];            //Lane Storage (Stable Addresses)
+  vector<int> active, next;             //Occupied Lanes, in Order
+  active.reserve(W);
+  next.reserve(W);
+
+  while((!tile.queue.empty() || !active.empty()) && !tile.exhausted()){
+
+    //Fill Free Lanes, Settle Stopped Particles
+    int l = 0;
+    while(active.size() < W && !tile.queue.empty()){
+      Pending p = std::move(tile.queue.front());
+      tile.queue.pop_front();
+      if(p.flooding && !settle(tile, p, map))
+        continue;
+      while(lane[l]) l++;
+      lane[l].emplace(std::move(p));
+      active.push_back(l);
+    }
+
+    //Handoff Lanes Leaving the Tile
+    for(auto& l: active){
+      const ivec2 pos = round(lane[l]->particle.pos);
+      if(inside(tile, pos)){
+        next.push_back(l);
+        continue;
+      }
+      tile.outbox.push_back({tileof(pos), std::move(*lane[l])});
+      lane[l].reset();
+    }
+    active.swap(next);
+    next.clear();
+
+    //Move in Lockstep, Interact per Particle
+    P.n = active.size();
+    tile.steps += P.n;
+    for(int k = 0; k < P.n; k++)
+      P.particle[k] = &lane[active[k]]->particle;
+    WaterParticle::move(map, P);
+
+    for(int k = 0; k < P.n; k++){
+      const int l = active[k];
+      if((P.moved[k] && lane[l]->particle.interact(map)) || settle(tile, *lane[l], map))
+        next.push_back(l);
+      else lane[l].reset();
+    }
+    active.swap(next);
+    next.clear();
+
+    tile.spills += spawned.size();
+    for(auto& s: spawned)
+      tile.queue.push_back({s});
+    spawned.clear();
+
+  }
+
+  //Out of Budget: Lanes Resume Next Cycle, in Order
+  for(auto l = active.rbegin(); l != active.rend(); l++)
+    tile.queue.push_front(std::move(*lane[*l]));
+
+  tile.depth = std::max(tile.depth, WaterParticle::maxdepth);
+  WaterParticle::spawned = NULL;
+
+}
+
+/*
+================================================================================
+                          Water Spawn Density
+================================================================================
+*/
+
+enum Rain {
+  UNIFORM,                      //Uniform over the Map
+  RAINFALL,                     //Rainfall Texture
+  ALTITUDE,                     //Proportional to Height
+  FREQUENCY                     //Proportional to Flow Frequency
+};
+
+Rain RAIN = UNIFORM;
+const float MINRAIN = 0.05f;    //Base Density of Frequency Driven Rain
+
+vector<float> rainfall;         //Rainfall Texture (Index x*dim.y+y)
+dist::alias density;            //Spawn Cell Sampler
+Rain sampled = UNIFORM;         //Mode the Sampler was Built for
+
+//Rebuild the Spawn Cell Sampler from the Density Map
+void rain(Layermap& map){
+
+  const int X = map.dim.x;
+  const int Y = map.dim.y;
+  vector<float> weight(X*Y, 1.0f);
+
+  if(RAIN == RAINFALL && rainfall.size() == weight.size())
+    weight = rainfall;
+
+  if(RAIN == ALTITUDE){
+    const double* H = map.heightmap();
+    for(int k = 0; k < X*Y; k++)
+      weight[k] = H[k];
+  }
+
+  if(RAIN == FREQUENCY)
+  for(int x = 0; x < X; x++)
+  for(int y = 0; y < Y; y++)
+    weight[x*Y+y] = MINRAIN + WaterParticle::frequency[y*X+x];
+
+  density.build(weight);
+  sampled = RAIN;
+
+}
+
+//Spawn Position of the i-th Water Particle in a Cycle
+vec2 raindrop(Layermap& map, uint64_t cycle, uint64_t i){
+  if(RAIN == UNIFORM)
+    return Particle::spawn(map.dim, WATERSPAWN, cycle, i);
+  const uint32_t c = density.sample(dist::hash(SEED, WATERSPAWN, (cycle << 32) | i));
+  return vec2(c / map.dim.y, c % map.dim.y);
+}
+
+/*
+================================================================================
+                          Hydraulic Erosion Cycle
+================================================================================
+*/
+
+//Drop a Particle, Leaving its Sediment where it Stands (Water Evaporates)
+void deposit(WaterParticle& particle, Layermap& map){
+  if(particle.volume < particle.minvol)
+    return;
+  map.add(particle.pos, map.pool.get(particle.sediment*surf.equrate[particle.contains], particle.contains));
+}
+
+//Steps Left of the Cycle's Budget
+size_t left(){
+  size_t steps = 0;
+  for(auto& tile: tiles)
+    steps += tile.steps;
+  return (steps < (size_t)BUDGET) ? BUDGET - steps : 0;
+}
+
+//Share the Steps Left among the Tiles of a Color, by their Queue Length
+void share(int color){
+
+  size_t queued = 0;
+  for(auto& tile: tiles)
+    queued += tile.queue.size();
+
+  const size_t steps = left();
+  for(size_t t = 0; t < tiles.size(); t++)
+  if(colorof(t) == color){
+    Tile& tile = tiles[t];
+    const size_t n = tile.queue.size();
+    const size_t s = (queued == 0 || steps == 0) ? 0 : (steps*n + queued - 1)/queued;
+    tile.budget = tile.steps + s;
+  }
+
+}
+
+//Simulate the Queued Particles of all Tiles, in Phases of one Color
+void run(Layermap& map){
+
+  bool done = false;
+  for(int pass = 0; pass < MAXROUNDS && !done; pass++){
+
+    for(int color = 0; color < 4; color++){
+
+      if(BUDGET > 0)
+        share(color);
+
+      vector<int> active;
+      for(size_t t = 0; t < tiles.size(); t++)
+        if(colorof(t) == color && !tiles[t].queue.empty() && !tiles[t].exhausted())
+          active.push_back(t);
+
+      #pragma omp parallel for schedule(dynamic)
+      for(size_t k = 0; k < active.size(); k++){
+        if(PACKETS) packets(tiles[active[k]], map);
+        else process(tiles[active[k]], map);
+      }
+
+      for(auto& tile: tiles){     //Handoff in Tile Order
+        for(auto& [t, p]: tile.outbox)
+          tiles[t].queue.push_back(p);
+        tile.outbox.clear();
+      }
+
+    }
+
+    done = true;
+    for(auto& tile: tiles)
+      done = done && tile.queue.empty();
+    done = done || (BUDGET > 0 && left() == 0);
+
+  }
+
+  //Serial Fallback for Particles Crossing Tiles Repeatedly
+  //Budgeted: Only while Steps are Left, the Rest Continues Next Cycle
+  size_t steps = (BUDGET > 0) ? left() : 0;
+  const auto spent = [&](){
+    return BUDGET > 0 && steps == 0;
+  };
+
+  for(auto& tile: tiles){
+    WaterParticle::maxdepth = 0;
+    while(!tile.queue.empty() && !spent()){
+      Pending p = tile.queue.front();
+      tile.queue.pop_front();
+      WaterParticle& particle = p.particle;
+      bool paused = false;
+      const auto step = [&](){
+        if(spent()){
+          p.flooding = false;     //Resumes Stepping
+          paused = true;
+          return false;
+        }
+        tile.steps++;
+        if(BUDGET > 0) steps--;
+        return particle.move(map) && particle.interact(map);
+      };
+      if(!p.flooding)
+        while(step());
+      while(!paused){
+        if(spent()){
+          p.flooding = true;      //Resumes at Flood
+          paused = true;
+          break;
+        }
+        if(!particle.flood(map))
+          break;
+        while(step());
+      }
+      if(paused)                  //Resumes Next Cycle
+        tile.queue.push_front(p);
+    }
+    tile.depth = std::max(tile.depth, WaterParticle::maxdepth);
+  }
+
+  //Counters since the Start of the Cycle, in Tile Order
+  counters.steps = counters.spills = counters.pending = 0;
+  for(auto& tile: tiles){
+    counters.steps += tile.steps;
+    counters.spills += tile.spills;
+    counters.pending += tile.queue.size();
+    counters.depth = std::max(counters.depth, tile.depth);
+  }
+
+}
+
+//Simulate N Water Particles over the Tiles
+void water(Layermap& map, int N, uint64_t cycle){
+
+  if(tiles.empty() || tiles.back().max != map.dim)
+    partition(map);
+
+  counters = Counters();
+  counters.spawned = N;
+  for(auto& tile: tiles){
+    tile.budget = tile.steps = tile.spills = 0;
+    tile.depth = 0;
+  }
+
+  //Deposit Particles that Stayed Pending too Long, in Tile Order
+  for(auto& tile: tiles){
+    deque<Pending> queue;
+    for(auto& p: tile.queue){
+      if(++p.age <= BACKLOG)
+        queue.push_back(p);
+      else {
+        deposit(p.particle, map);
+        counters.deposited++;
+      }
+    }
+    tile.queue.swap(queue);
+    counters.carried += tile.queue.size();
+  }
+
+  //Density Follows the Map, Rainfall Only Changes on Load
+  const bool stale = (RAIN != sampled) || density.prob.size() != (size_t)(map.dim.x*map.dim.y);
+  if(RAIN == ALTITUDE || RAIN == FREQUENCY || (RAIN == RAINFALL && stale))
+    rain(map);
+
+  for(int i = 0; i < N; i++){     //Spawn in Order
+    WaterParticle particle(map, raindrop(map, cycle, i));
+    tiles[tileof(particle.ipos)].queue.push_back({particle});
+  }
+
+  run(map);
+
+}
+
+/*
+================================================================================
+                      Two-Phase (Parallel) Groundwater Seep
+================================================================================
+
+Seeping is split into a vertical and a lateral phase. Vertical percolation only
+modifies its own column, so columns are seeped in parallel (in rows of one
+residue mod 3, as a column change invalidates the normals of its neighbors).
+The lateral exchange cascades the standing water of every cell, reaching no
+further than a particle, so it runs over the tiles of one color in parallel.
+Its spill particles are queued in the tiles and simulated like new particles.
+
+Only active columns percolate. The layermap activates a column when water is
+added to it, and a column goes dormant once a seep moves no more water, i.e.
+its saturation profile is at equilibrium. The lateral phase only cascades cells
+with standing water, so on dry maps the groundwater cost follows the wet cells.
+
+*/
+
+//Cascade the Standing Water of every Cell of a Tile
+void spread(Tile& tile, Layermap& map){
+
+  vector<WaterParticle> spawned;
+  WaterParticle::spawned = &spawned;
+  WaterParticle::maxdepth = 0;
+
+  const SurfType* S = map.surfacemap();
+  for(int x = tile.min.x; x < tile.max.x; x++)
+  for(int y = tile.min.y; y < tile.max.y; y++)
+    if(S[x*map.dim.y+y] == surf.air)  //Dry Cells only Receive
+      WaterParticle::cascade(ivec2(x, y), map, 3);
+
+  tile.spills += spawned.size();
+  for(auto& s: spawned)
+    tile.queue.push_back({s});
+
+  tile.depth = std::max(tile.depth, WaterParticle::maxdepth);
+  WaterParticle::spawned = NULL;
+
+}
+
+//Seep Water into the Ground and Spread it
+void seep(Layermap& map){
+
+  if(tiles.empty() || tiles.back().max != map.dim)
+    partition(map);
+
+  //Vertical: Column-Local Percolation of Active Columns
+  map.gather();
+  vector<int>& active = map.activated;
+  sort(active.begin(), active.end());
+  counters.seeping = active.size();
+
+  vector<vector<int>> byrow(map.dim.x);
+  for(auto& ind: active)
+    byrow[ind/map.dim.y].push_back(ind);
+
+  //Rows of one Residue (mod 3) Touch Disjoint Normals
+  for(int r = 0; r < 3; r++){
+    #pragma omp parallel for
+    for(int x = r; x < map.dim.x; x += 3)
+    for(auto& ind: byrow[x])
+      if(!WaterParticle::seep(ivec2(x, ind%map.dim.y), map))
+        map.active[ind] = false;      //Equilibrium: Dormant
+  }
+
+  active.erase(std::remove_if(active.begin(), active.end(), [&](int ind){
+    return !map.active[ind];
+  }), active.end());
+
+  if(pipes::ENABLED){             //Lateral Flow by the Pipes Solver
+    pipes::solve(map);
+    return;
+  }
+
+  //Lateral: Water Cascade, Tiles of one Color in Parallel
+  for(int color = 0; color < 4; color++){
+
+    vector<int> active;
+    for(size_t t = 0; t < tiles.size(); t++)
+      if(colorof(t) == color)
+        active.push_back(t);
+
+    #pragma omp parallel for schedule(dynamic)
+    for(size_t k = 0; k < active.size(); k++)
+      spread(tiles[active[k]], map);
+
+  }
+
+  run(map);                       //Spill Particles
+
+}
+
+/*
+================================================================================
+                        Culled Wind Particle Spawning
+================================================================================
+
+A wind particle only moves if the soil it spawns on is transported as a type
+with a suspension rate. Spawn positions are pure hashes, so they are drawn
+first and particles are only constructed on suspendable cells, against a mask
+by surface type. On mostly rocky maps, a wind cycle costs N hashes. Results are
+identical to spawning all N particles.
+
+*/
+
+void wind(Layermap& map, int N, uint64_t cycle){
+
+  if(!surf.wind)                  //No Suspendable Soil
+    return;
+
+  const SurfType* S = map.surfacemap();
+  for(int i = 0; i < N; i++){
+    const ivec2 pos = Particle::spawn(map.dim, WINDSPAWN, cycle, i);
+    if(!surf.suspendable[S[pos.x*map.dim.y+pos.y]])
+      continue;
+    WindParticle particle(map, cycle, i);
+    while(particle.move(map) && particle.interact(map));
+  }
+
+}
+
+}
@@ -17,6 +17,27 @@ using namespace glm;
 random_device rd;
 mt19937 gen(rd());
 
+void seed(unsigned int s){        //Reproducible Sampling
+  gen.seed(s);
+}
+
+/*
+  Counter-Based Generator: A random number is a pure hash (SplitMix64) of its
+  key, so it is independent of the order in which numbers are drawn. Streams
+  are keyed by seed and purpose, numbers within a stream by a counter.
+*/
+
+inline uint64_t splitmix(uint64_t x){
+  x += 0x9E3779B97F4A7C15ULL;
+  x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+  return x ^ (x >> 31);
+}
+
+inline uint64_t hash(uint64_t seed, uint64_t stream, uint64_t counter){
+  return splitmix(splitmix(splitmix(seed) ^ stream) ^ counter);
+}
+
 //Base Distributions
 bernoulli_distribution brn(0.5);
 bool bernoulli(){
@@ -65,5 +86,60 @@ vec3 normal(vec3 mean, vec3 std){
   return sample;
 }
 
+/*
+  Alias Table (Vose): Samples an index of a discrete distribution of n weights
+  in constant time from a single 64-bit random number, which picks a bucket
+  and flips the biased coin between the bucket and its alias.
+*/
+
+struct alias {
+
+  vector<float> prob;         //Probability of Keeping the Bucket
+  vector<uint32_t> other;     //Alias of the Bucket
+
+  void build(const vector<float>& weight){
+
+    const size_t n = weight.size();
+    prob.assign(n, 1.0f);
+    other.resize(n);
+    for(size_t k = 0; k < n; k++)
+      other[k] = k;
+
+    double sum = 0.0;
+    for(auto& w: weight)
+      sum += w;
+    if(sum <= 0.0)            //Degenerate: Uniform
+      return;
+
+    vector<double> p(n);
+    vector<uint32_t> small, large;
+    for(size_t k = 0; k < n; k++){
+      p[k] = weight[k]*n/sum;
+      if(p[k] < 1.0) small.push_back(k);
+      else large.push_back(k);
+    }
+
+    while(!small.empty() && !large.empty()){
+      const uint32_t s = small.back(); small.pop_back();
+      const uint32_t l = large.back();
+      prob[s] = p[s];
+      other[s] = l;
+      p[l] -= 1.0 - p[s];
+      if(p[l] < 1.0){
+        large.pop_back();
+        small.push_back(l);
+      }
+    }
+
+  }
+
+  uint32_t sample(uint64_t h) const {
+    const uint32_t k = (h >> 32) % prob.size();   //High Bits: Bucket
+    const float u = (h & 0xFFFFFF) * 0x1p-24f;    //Low Bits: Coin in [0, 1)
+    return (u < prob[k]) ? k : other[k];
+  }
+
+};
+
 
 }
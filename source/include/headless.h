@@ -0,0 +1,181 @@
+/*
+================================================================================
+                  Headless Replacements for TinyEngine Utilities
+================================================================================
+
+Allows for building the simulation without OpenGL / SDL. The vertexpool has the
+same interface as the persistently mapped GL version, but is backed by regular
+memory so that the layermap can still be meshed and exported.
+
+*/
+
+#ifndef SOILMACHINE_HEADLESS_INCLUDE
+#define SOILMACHINE_HEADLESS_INCLUDE
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <deque>
+#include <set>
+#include <map>
+#include <functional>
+#include <algorithm>
+#include <chrono>
+
+#include <glm/glm.hpp>
+
+using namespace glm;
+using namespace std;
+
+/*
+================================================================================
+                        Commandline Argument Parsing
+================================================================================
+*/
+
+namespace parse {
+
+map<string, string> option;   //Options with Values:  -key value
+set<string> flag;             //Flags without Values: --key
+
+void get(int argc, char* args[]){
+
+  for(int i = 1; i < argc; i++){
+
+    string arg = args[i];
+    if(arg.size() < 2 || arg[0] != '-'){
+      cout<<"Ignoring Argument "<<arg<<endl;
+      continue;
+    }
+
+    if(arg[1] == '-'){
+      flag.insert(arg.substr(2));
+      continue;
+    }
+
+    if(i+1 >= argc){
+      cout<<"Missing Value for Option "<<arg<<endl;
+      continue;
+    }
+
+    option[arg.substr(1)] = args[++i];
+
+  }
+
+}
+
+}
+
+/*
+================================================================================
+                          Memory-Backed Vertex Pool
+================================================================================
+*/
+
+using uint = unsigned int;
+
+struct Vertex {
+
+	Vertex(vec3 p, vec3 n, vec4 c, int i){
+		position[0] = p.x;
+		position[1] = p.y;
+		position[2] = p.z;
+		normal[0] = n.x;
+		normal[1] = n.y;
+		normal[2] = n.z;
+		color[0] = c.x;
+		color[1] = c.y;
+		color[2] = c.z;
+		color[3] = c.w;
+		index = i;
+	}
+
+	float position[3];
+	float normal[3];
+	float color[4];
+	float index;
+
+};
+
+template<typename T>
+class Vertexpool {
+private:
+
+size_t K = 0;   //Number of Vertices per Bucket
+size_t N = 0;   //Number of Maximum Buckets
+
+T* start = NULL;
+deque<T*> free;
+vector<uint*> sections;
+
+public:
+
+vector<uint> indices;
+
+Vertexpool(int k, int n){
+  reserve(k, n);
+}
+
+~Vertexpool(){
+  while(!sections.empty())
+    unsection(sections.back());
+  ::operator delete(start);
+}
+
+void reserve(const int k, const int n){
+
+  K = k; N = n;
+  start = (T*)::operator new(N*K*sizeof(T));
+  for(size_t i = 0; i < N; i++)
+    free.push_front(start+i*K);
+
+}
+
+uint* section(const int size, const int group = 0, vec3 pos = vec3(0)){
+
+  if(size == 0 || size > K){
+    std::cout<<"Vertexpool Error: Insufficient Bucket Size"<<std::endl;
+    return NULL;
+  }
+  if(free.empty()){
+    std::cout<<"Vertexpool Error: No More Buckets Available"<<std::endl;
+    return NULL;
+  }
+
+  sections.push_back(new uint(free.back()-start));
+  free.pop_back();
+  return sections.back();
+
+}
+
+void unsection(uint* index){
+
+  if(index == NULL){
+    std::cout<<"Vertexpool Error: Can't Unsection - Index is NULL"<<std::endl;
+    return;
+  }
+
+  free.push_front(start+*index);
+  sections.erase(std::find(sections.begin(), sections.end(), index));
+  delete index;
+
+}
+
+T* get(uint* ind, int k){
+  return start + *ind + k;
+}
+
+template<typename... Args>
+void fill(uint* ind, int k, Args && ...args){
+  new (get(ind, k)) T(forward<Args>(args)...);
+}
+
+//No Buffers to Synchronize
+void resize(const uint* index, const int newsize){}
+void index(){}
+void update(){}
+
+};
+
+#endif
@@ -4,6 +4,8 @@
 ================================================================================
 */
 
+#include <iomanip>
+
 void loadsoil( string file = "soil/default.soil" ){
 
   ifstream in(file, ios::in);
@@ -217,20 +219,201 @@ void loadsoil( string file = "soil/default.soil" ){
         NWIND = stoi(val);
       if(tag == "NWATER")
         NWATER = stoi(val);
+      if(tag == "POOLSIZE")
+        POOLSIZE = stoi(val);
     }
 
   }
 
   in.close();
 
+  #ifdef SOILMACHINE_COMPACT
+  if(soils.size() > 256){           //8-Bit Type Index
+    cout<<"Error: Compact mode supports at most 256 soil types ("<<soils.size()<<" in "<<file<<")"<<endl;
+    exit(0);
+  }
+  #endif
+
   // Set the Phong Lighting
   for(size_t i = 0; i < soils.size(); i++)
     phong.push_back(soils[i].phong);
 
+  surf.build();                     //Hot Parameter Table
+
 }
 
 //Should be able to also WRITE to file!!
 
+//Freeze the Loaded Soil Profile into a Header for SOILMACHINE_FROZEN
+void freezesoil(string filename = "source/frozen.h", string profile = "soil/default.soil"){
+
+  cout<<"Freezing Soil Profile "<<profile<<" to "<<filename<<endl;
+  ofstream out(filename, ios::out);
+  if(!out.is_open()){
+    cout<<"Error: Failed to open "<<filename<<endl;
+    exit(0);
+  }
+
+  const size_t N = soils.size();
+  out<<scientific<<setprecision(9)<<boolalpha;   //Round-Trips Single Precision
+
+  const auto list = [&](string type, string name, auto& field, string suffix){
+    out<<"  static constexpr "<<type<<" "<<name<<"[N] = {";
+    for(size_t t = 0; t < N; t++)
+      out<<((t == 0) ? " " : ", ")<<field[t]<<suffix;
+    out<<" };"<<endl;
+  };
+
+  out<<"/*"<<endl;
+  out<<"    Frozen Soil Profile, Generated from "<<profile<<endl;
+  out<<"    by soilmachine-headless -freeze. Regenerate when the profile changes."<<endl;
+  out<<"*/"<<endl<<endl;
+  out<<"namespace frozen {"<<endl<<endl;
+  out<<"struct SurfProfile {"<<endl<<endl;
+  out<<"  static constexpr const char* profile = \""<<profile<<"\";"<<endl;
+  out<<"  static constexpr size_t N = "<<N<<";"<<endl;
+  out<<"  static constexpr SurfType air = "<<surf.air<<";"<<endl<<endl;
+  out<<"  static constexpr bool wind = "<<(surf.wind ? "true" : "false")<<";"<<endl;
+  out<<"  static constexpr bool seeping = "<<(surf.seeping ? "true" : "false")<<";"<<endl;
+  out<<"  static constexpr bool cascading = "<<(surf.cascading ? "true" : "false")<<";"<<endl;
+  out<<"  static constexpr bool converting = "<<(surf.converting ? "true" : "false")<<";"<<endl<<endl;
+
+  list("float", "density", surf.density, "f");
+  list("float", "porosity", surf.porosity, "f");
+  list("SurfType", "transports", surf.transports, "");
+  list("float", "solubility", surf.solubility, "f");
+  list("float", "equrate", surf.equrate, "f");
+  list("float", "friction", surf.friction, "f");
+  list("SurfType", "erodes", surf.erodes, "");
+  list("float", "erosionrate", surf.erosionrate, "f");
+  list("SurfType", "cascades", surf.cascades, "");
+  list("float", "maxdiff", surf.maxdiff, "f");
+  list("float", "settling", surf.settling, "f");
+  list("SurfType", "abrades", surf.abrades, "");
+  list("float", "suspension", surf.suspension, "f");
+  list("float", "abrasion", surf.abrasion, "f");
+  list("bool", "suspendable", surf.suspendable, "");
+
+  out<<endl<<"};"<<endl<<endl;
+  out<<"}"<<endl;
+  out.close();
+
+}
+
+//Raw Double-Precision Heightmap (Index x*SIZEY+y), e.g. for Validation
+void exportraw(Layermap& map, string filename = "height.raw"){
+  cout<<"Exporting Raw Heightmap"<<endl;
+  ofstream out(filename, ios::out | ios::binary);
+  for(int x = 0; x < map.dim.x; x++)
+  for(int y = 0; y < map.dim.y; y++){
+    double h = map.height(ivec2(x, y));
+    out.write((char*)&h, sizeof(double));
+  }
+  out.close();
+}
+
+//Compare against Raw Heightmap, Print Error Metrics
+//Returns True if the RMS Error is within the Tolerance (World Units)
+bool compareraw(Layermap& map, string filename = "height.raw", double tolerance = 0.5){
+
+  ifstream in(filename, ios::in | ios::binary);
+  if(!in.is_open()){
+    cout<<"Error: Failed to open raw heightmap "<<filename<<endl;
+    return false;
+  }
+
+  double maxerr = 0.0, sqerr = 0.0, sum = 0.0, rsum = 0.0;
+  const int N = map.dim.x*map.dim.y;
+  for(int x = 0; x < map.dim.x; x++)
+  for(int y = 0; y < map.dim.y; y++){
+    double r = 0.0;
+    if(!in.read((char*)&r, sizeof(double))){
+      cout<<"Error: Raw heightmap "<<filename<<" has wrong size"<<endl;
+      return false;
+    }
+    double h = map.height(ivec2(x, y));
+    double err = abs(h - r);
+    if(err > maxerr) maxerr = err;
+    sqerr += err*err;
+    sum += h;
+    rsum += r;
+  }
+
+  cout<<"Heightmap Comparison against "<<filename<<endl;
+  cout<<"  Max. Abs. Error: "<<maxerr<<" ("<<maxerr*SCALE<<" World Units)"<<endl;
+  cout<<"  RMS Error: "<<sqrt(sqerr/N)<<" ("<<sqrt(sqerr/N)*SCALE<<" World Units)"<<endl;
+  cout<<"  Mean Height: "<<sum/N<<" (Reference "<<rsum/N<<")"<<endl;
+
+  const bool pass = sqrt(sqerr/N)*SCALE <= tolerance;
+  cout<<"  "<<(pass ? "Passed" : "Failed")<<" (Tolerance "<<tolerance<<" World Units RMS)"<<endl;
+  return pass;
+
+}
+
+//Rainfall Texture, Resampled to the Map (Binary .pgm, 8 or 16 Bit)
+vector<float> loadrainfall(string filename){
+
+  ifstream in(filename, ios::in | ios::binary);
+  string magic;
+  int w = 0, h = 0, maxval = 0;
+  in>>magic>>w>>h>>maxval;
+  in.get();                         //Single Whitespace before Data
+  if(!in.is_open() || magic != "P5" || w <= 0 || h <= 0 || maxval <= 0 || maxval > 65535){
+    cout<<"Error: Failed to load rainfall texture "<<filename<<endl;
+    exit(0);
+  }
+
+  cout<<"Loading Rainfall Texture "<<filename<<" ("<<w<<"x"<<h<<")"<<endl;
+  vector<float> img(w*h);
+  for(auto& v: img){
+    int val = in.get();
+    if(maxval > 255)                //16-Bit PGM is Big-Endian
+      val = (val << 8) | in.get();
+    v = (float)val/maxval;
+  }
+
+  //Nearest Neighbor Resampling to the Map
+  vector<float> rainfall(SIZEX*SIZEY);
+  for(int x = 0; x < SIZEX; x++)
+  for(int y = 0; y < SIZEY; y++)
+    rainfall[x*SIZEY+y] = img[(y*h/SIZEY)*w + (x*w/SIZEX)];
+
+  return rainfall;
+
+}
+
+#ifdef SOILMACHINE_HEADLESS
+
+//Export Functions (Portable Anymap, No SDL)
+void exportcolor(Layermap& map, Vertexpool<Vertex>& vertexpool, string filename = "color.ppm"){
+  cout<<"Exporting Color Image"<<endl;
+  ofstream out(filename, ios::out | ios::binary);
+  out<<"P6\n"<<SIZEX<<" "<<SIZEY<<"\n255\n";
+  for(int y = 0; y < SIZEY; y++)
+  for(int x = 0; x < SIZEX; x++){
+    Vertex* v = vertexpool.get(map.section, x*SIZEY+y);
+    for(int c = 0; c < 3; c++)
+      out.put((unsigned char)(255.0f*glm::clamp(v->color[c], 0.0f, 1.0f)));
+  }
+  out.close();
+}
+
+void exportheight(Layermap& map, Vertexpool<Vertex>& vertexpool, string filename = "height.pgm"){
+  cout<<"Exporting Height Image"<<endl;
+  ofstream out(filename, ios::out | ios::binary);
+  out<<"P5\n"<<SIZEX<<" "<<SIZEY<<"\n65535\n";
+  for(int y = 0; y < SIZEY; y++)
+  for(int x = 0; x < SIZEX; x++){
+    Vertex* v = vertexpool.get(map.section, x*SIZEY+y);
+    unsigned short h = 65535.0f*glm::clamp(v->position[1]/SCALE/(float)sqrt(2), 0.0f, 1.0f);
+    out.put(h >> 8);  //16-Bit PGM is Big-Endian
+    out.put(h & 0xFF);
+  }
+  out.close();
+}
+
+#else
+
 void exportcolor(Layermap& map, Vertexpool<Vertex>& vertexpool, string filename = "color.png"){
   cout<<"Exporting Color Image"<<endl;
   SDL_Surface* img = image::make([&](ivec2 i){
@@ -250,3 +433,5 @@ void exportheight(Layermap& map, Vertexpool<Vertex>& vertexpool, string filename
   }, ivec2(SIZEX, SIZEY));
   image::save(img, filename);
 }
+
+#endif
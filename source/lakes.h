@@ -0,0 +1,97 @@
+/*
+================================================================================
+              Priority-Flood Depression Filling (Lake Initialization)
+================================================================================
+
+Lakes normally form as particles stall and flood, which takes many cycles for
+large basins. The spill height of every cell, i.e. the lowest level at which
+water on it could drain off the map, is instead found in one O(n log n) pass:
+starting from the map boundary, cells are visited lowest first from a priority
+queue, and every newly reached neighbor gets the maximum of its own ground
+height and the spill height of the cell it was reached from.
+
+Cells whose spill height is above their ground lie in a basin. Setting the
+standing water of all cells to a fraction of this depth pre-fills the lakes (1)
+or drains them (0), for a hydrologically consistent state at startup.
+
+*/
+
+#include <queue>
+
+namespace lakes {
+
+//Spill Height of every Cell (Index x*dim.y+y)
+vector<double> spill(Layermap& map){
+
+  const int X = map.dim.x;
+  const int Y = map.dim.y;
+  const double* H = map.heightmap();
+
+  vector<double> ground(X*Y);
+  for(int x = 0; x < X; x++)
+  for(int y = 0; y < Y; y++)
+    ground[x*Y+y] = H[x*Y+y] - map.standing(ivec2(x, y));
+
+  using Cell = pair<double, int>;
+  priority_queue<Cell, vector<Cell>, greater<Cell>> open;
+  vector<double> level(X*Y);
+  vector<bool> closed(X*Y, false);
+
+  for(int x = 0; x < X; x++)    //Boundary Drains off the Map
+  for(int y = 0; y < Y; y++){
+    if(x > 0 && x < X-1 && y > 0 && y < Y-1) continue;
+    const int i = x*Y+y;
+    level[i] = ground[i];
+    closed[i] = true;
+    open.push({level[i], i});
+  }
+
+  while(!open.empty()){
+
+    const auto [h, i] = open.top();
+    open.pop();
+
+    const int x = i/Y, y = i%Y;
+    for(int nx = std::max(x-1, 0); nx <= std::min(x+1, X-1); nx++)
+    for(int ny = std::max(y-1, 0); ny <= std::min(y+1, Y-1); ny++){
+      const int n = nx*Y+ny;
+      if(closed[n]) continue;
+      closed[n] = true;
+      level[n] = std::max(ground[n], h);
+      open.push({level[n], n});
+    }
+
+  }
+
+  return level;
+
+}
+
+//Set Standing Water to a Fraction of the Basin Depth (1: Fill, 0: Drain)
+void fill(Layermap& map, double fraction = 1.0){
+
+  vector<double> level = spill(map);
+  const double* H = map.heightmap();
+
+  size_t basin = 0;
+  double volume = 0.0;
+
+  for(int x = 0; x < map.dim.x; x++)
+  for(int y = 0; y < map.dim.y; y++){
+
+    const ivec2 pos = ivec2(x, y);
+    const int i = x*map.dim.y+y;
+    const double depth = level[i] - (H[i] - map.standing(pos));
+
+    if(depth > Layermap::MINWATER) basin++;
+    volume += fraction*depth;
+
+    map.standing(pos, fraction*depth);
+
+  }
+
+  cout<<"Lakes: "<<basin<<" Cells in Basins, Volume "<<volume<<endl;
+
+}
+
+}
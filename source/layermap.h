@@ -19,6 +19,8 @@ Air e.g. has porosity 1
 */
 
 //#define SOILMACHINE_MASK
+//#define SOILMACHINE_COLUMNS     //Contiguous Per-Cell Columns instead of Pooled Linked-List
+//#define SOILMACHINE_COMPACT     //Single-Precision / Quantized Layer Elements
 
 #include "include/FastNoiseLite.h"
 
@@ -26,6 +28,11 @@ Air e.g. has porosity 1
 using namespace glm;
 using namespace std;
 
+#ifdef _OPENMP
+#include <omp.h>
+#include <mutex>
+#endif
+
 /*
 ================================================================================
                   RLE Linked-List Element and Memory Pool
@@ -34,28 +41,63 @@ using namespace std;
 
 #include "surface.h"
 
+/*
+  Compact Mode: Sizes in single precision, type as an 8-bit index and the
+  saturation quantized to 8 bits, which reduces an element from 40 to 24 bytes.
+*/
+
+#ifdef SOILMACHINE_COMPACT
+
+struct unorm8 {           //Quantized Value in [0, 1]
+
+  unsigned char v = 0;
+
+  unorm8(){}
+  unorm8(double d){ *this = d; }
+
+  operator double() const { return v/255.0; }
+  unorm8& operator=(double d){
+    d = (d < 0.0) ? 0.0 : (d > 1.0) ? 1.0 : d;
+    v = (unsigned char)(255.0*d + 0.5);
+    return *this;
+  }
+  unorm8& operator+=(double d){ return *this = (double)*this + d; }
+  unorm8& operator-=(double d){ return *this = (double)*this - d; }
+
+};
+
+using secsize = float;
+using sectype = unsigned char;
+using secsat = unorm8;
+
+#else
+
+using secsize = double;
+using sectype = SurfType;
+using secsat = double;
+
+#endif
+
 struct sec {
 
 sec* next = NULL;     //Element Above
 sec* prev = NULL;     //Element Below
 
-SurfType type = soilmap["Air"];   //Type of Surface Element
-double size = 0.0f;               //Run-Length of Element
-double floor = 0.0f;              //Cumulative Height at Bottom
-double saturation = 0.0f;         //Saturation with Water
+secsize size = 0.0f;              //Run-Length of Element
+sectype type = surf.air;          //Type of Surface Element
+secsat saturation = 0.0f;         //Saturation with Water
+
+//Note: The floor (cumulative height at bottom) is not stored, but derived from
+//the layermap's height plane by walking down from the top.
 
 sec(){}
-sec(double s, SurfType t){
-  size = s;
-  type = t;
-}
+sec(double s, SurfType t): size(s), type(t){}
 
 void reset(){
   next = NULL;
   prev = NULL;
-  type = soilmap["Air"];
+  type = surf.air;
   size = 0.0f;
-  floor = 0.0f;
   saturation = 0.0f;
 }
 
@@ -64,41 +106,72 @@ void reset(){
 class secpool {
 public:
 
-int size;               //Number of Total Elements
-sec* start = NULL;      //Point to Start of Pool
-deque<sec*> free;       //Queue of Free Elements
+int size = 0;           //Number of Total Elements
+vector<sec*> slabs;     //Chunks of Elements (Never Moved)
+vector<int> slabsize;   //Number of Elements per Chunk
+sec* free = NULL;       //Intrusive List of Free Elements (Linked by next)
+int nfree = 0;          //Number of Free Elements in List
+int peak = 0;           //High-Water Mark of Used Elements
 
 secpool(){}             //Construct
 secpool(const int N){   //Construct with Size
   reserve(N);
 }
 ~secpool(){
-  free.clear();
-  delete[] start;
+  for(auto& slab: slabs)
+    delete[] slab;
 }
 
 //Create the Memory Pool
 void reserve(const int N){
-  start = new sec[N];
-  for(int i = 0; i < N; i++)
-    free.push_front(start+i);
-  size = N;
+  for(auto& slab: slabs)
+    delete[] slab;
+  slabs.clear();
+  slabsize.clear();
+  size = 0;
+  grow(N);
+  reset();
+}
+
+//Add a Chunk of Elements, Existing Elements Remain Valid
+void grow(const int N){
+  sec* slab = new sec[N];
+  for(int i = N-1; i >= 0; i--){
+    slab[i].next = free;
+    free = slab+i;
+  }
+  slabs.push_back(slab);
+  slabsize.push_back(N);
+  size += N;
+  nfree += N;
+}
+
+//Grow by Half the Current Size
+void grow(){
+  grow((size/2 > 1024) ? size/2 : 1024);
+  cout<<"Memory Pool Grown to "<<size<<" Elements"<<endl;
 }
 
 //Retrieve Element, Construct in Place
 template<typename... Args>
 sec* get(Args && ...args){
 
-  if(free.empty()){
-    cout<<"Memory Pool Out-Of-Elements"<<endl;
-    return NULL;
-  }
+  #ifdef _OPENMP
+  if(omp_in_parallel())
+    return construct(cached(), forward<Args>(args)...);
+  if(free == NULL)
+    reclaim();
+  #endif
 
-  sec* E = free.back();
-  try{ new (E)sec(forward<Args>(args)...); }
-  catch(...) { throw; }
-  free.pop_back();
-  return E;
+  if(free == NULL)
+    grow();
+
+  sec* E = free;
+  free = E->next;
+  nfree--;
+  if(size - nfree > peak)
+    peak = size - nfree;
+  return construct(E, forward<Args>(args)...);
 
 }
 
@@ -106,16 +179,156 @@ sec* get(Args && ...args){
 void unget(sec* E){
   if(E == NULL)
     return;
-  E->reset();
-  free.push_front(E);
+
+  #ifdef _OPENMP
+  if(omp_in_parallel()){
+    uncached(E);
+    return;
+  }
+  #endif
+
+  E->next = free;
+  free = E;
+  nfree++;
 }
 
 void reset(){
-  free.clear();
-  for(int i = 0; i < size; i++)
-    free.push_front(start+i);
+  free = NULL;
+  for(int k = slabs.size()-1; k >= 0; k--)
+  for(int i = slabsize[k]-1; i >= 0; i--){   //Retrieve in Address Order
+    slabs[k][i].next = free;
+    free = slabs[k]+i;
+  }
+  nfree = size;
+  peak = 0;
+  #ifdef _OPENMP
+  for(auto& c: caches)
+    c = cache();
+  #endif
+}
+
+//Number of Free Elements (Including Thread Caches)
+int available(){
+  int n = nfree;
+  #ifdef _OPENMP
+  for(auto& c: caches)
+    n += c.n;
+  #endif
+  return n;
+}
+
+#ifdef _OPENMP
+//Return all Thread-Cached Elements to the Shared List (Outside Parallel Region)
+void reclaim(){
+  for(auto& c: caches)
+  while(c.free != NULL){
+    sec* E = c.free;
+    c.free = E->next;
+    E->next = free;
+    free = E;
+    nfree++;
+  }
+  for(auto& c: caches)
+    c.n = 0;
+}
+#endif
+
+private:
+
+template<typename... Args>
+sec* construct(sec* E, Args && ...args){
+  if(E == NULL) return NULL;
+  try{ new (E)sec(forward<Args>(args)...); }
+  catch(...) { throw; }
+  return E;
 }
 
+/*
+  Thread-Safe Variant: Inside of a parallel region, each thread retrieves and
+  returns elements through its own cache, so that the common case is a single
+  pointer swap. The shared list is only locked to move batches of elements.
+*/
+
+#ifdef _OPENMP
+
+struct cache {
+  sec* free = NULL;
+  int n = 0;
+};
+
+static const int BATCH = 256;
+vector<cache> caches = vector<cache>(omp_get_num_procs());
+std::mutex lock;
+
+sec* cached(){
+
+  const size_t t = omp_get_thread_num();
+  if(t >= caches.size()){           //Unexpected Thread: Lock Every Time
+    std::lock_guard<std::mutex> guard(lock);
+    if(free == NULL) grow();
+    sec* E = free;
+    free = E->next;
+    nfree--;
+    return E;
+  }
+
+  cache& c = caches[t];
+
+  if(c.free == NULL){               //Refill Cache from Shared List
+    std::lock_guard<std::mutex> guard(lock);
+    if(free == NULL) grow();
+    while(free != NULL && c.n < BATCH){
+      sec* E = free;
+      free = E->next;
+      nfree--;
+      E->next = c.free;
+      c.free = E;
+      c.n++;
+    }
+    if(size - nfree > peak)
+      peak = size - nfree;
+  }
+
+  sec* E = c.free;
+  c.free = E->next;
+  c.n--;
+  return E;
+
+}
+
+void uncached(sec* E){
+
+  const size_t t = omp_get_thread_num();
+  if(t >= caches.size()){
+    std::lock_guard<std::mutex> guard(lock);
+    E->next = free;
+    free = E;
+    nfree++;
+    return;
+  }
+
+  cache& c = caches[t];
+  E->next = c.free;
+  c.free = E;
+  c.n++;
+
+  if(c.n < 2*BATCH)                 //Return Batch to Shared List
+    return;
+
+  std::lock_guard<std::mutex> guard(lock);
+  while(c.n > BATCH){
+    sec* F = c.free;
+    c.free = F->next;
+    c.n--;
+    F->next = free;
+    free = F;
+    nfree++;
+  }
+
+}
+
+#endif
+
 };
 
 /*
@@ -128,7 +341,31 @@ class Layermap {
 
 private:
 
+#ifdef SOILMACHINE_COLUMNS
+vector<sec>* dat = NULL;                  //Raw Data Grid (Contiguous Columns, Bottom First)
+#else
 sec** dat = NULL;                         //Raw Data Grid
+#endif
+
+//Top Surface (Dense, Maintained by Modifiers)
+double* heights = NULL;                   //Column Height (Sum of Sizes)
+SurfType* surfaces = NULL;                //Type of Top Element
+void sync(ivec2);                         //Re-Read Top Element Type
+
+//Normal Field (Dense, Recomputed on Read where Heights Changed)
+vec3* normals = NULL;                     //Cached Normal Vector
+bool* stale = NULL;                       //Height of Cell or Neighbor Changed
+vec3 computenormal(ivec2);                //Normal Vector from Height Plane
+void invalidate(ivec2 pos){               //Normals of Cell and Neighbors are Stale
+  for(int i = std::max(pos.x-1, 0); i <= std::min(pos.x+1, dim.x-1); i++)
+  for(int j = std::max(pos.y-1, 0); j <= std::min(pos.y+1, dim.y-1); j++)
+    stale[i*dim.y+j] = true;
+}
+
+//Column Primitives
+void push(ivec2, sec*);                   //Place Element on Top of Column
+void pop(ivec2);                          //Remove and Return Top Element to Pool
+sec* lift(ivec2);                         //Detach Top Element as Free Pool Element
 
 public:
 
@@ -143,14 +380,38 @@ vec3 normal(vec2);                        //Normal Vector at Position (Bilinear
 vec3 normal(ivec2, Vertexpool<Vertex>&);  //Normal Vector at Position (Read from Vertexpool)
 vec3 normal(vec2, Vertexpool<Vertex>&);   //Normal Vector at Position (Read from Vertexpool)
 SurfType surface(ivec2);                  //Surface Type at Position
+const double* heightmap(){ return heights; }     //Dense Height Plane (Index x*dim.y+y)
+const SurfType* surfacemap(){ return surfaces; } //Dense Surface Plane (Index x*dim.y+y)
+const vec3* normalmap(){ return normals; }       //Dense Normal Plane (Valid where Read)
+void invalidate(){                        //All Normals are Stale (World Scale Changed)
+  for(int i = 0; i < dim.x*dim.y; i++)
+    stale[i] = true;
+}
 
 //Modifiers
 void add(ivec2, sec*);                    //Add Layer at Position
 double remove(ivec2, double);             //Remove Layer at Position
 sec* top(ivec2 pos){                      //Top Element at Position
+  #ifdef SOILMACHINE_COLUMNS
+  vector<sec>& column = dat[pos.x*dim.y+pos.y];
+  return column.empty() ? NULL : &column.back();
+  #else
   return dat[pos.x*dim.y+pos.y];
+  #endif
 }
 
+void restack(ivec2);                      //Recompute Column Height from Sizes
+void shrink(ivec2, sec*, double);         //Remove Amount from Any Element in Column
+
+//Standing Water (Top Air Section)
+static constexpr double MINWATER = 1E-8;  //Smallest Standing Water Change
+double standing(ivec2);                   //Standing Water Height at Position
+void standing(ivec2, double);             //Set Standing Water Height (Saturated)
+
+//Compaction
+int compact(double, bool);                //Merge / Drop Runs, Returns Elements Reclaimed
+int compact(ivec2, double);               //Compact Column at Position
+
 //Meshing / Visualization
 uint* section = NULL;                     //Vertexpool Section Pointer
 void meshpool(Vertexpool<Vertex>&);       //Mesh based on Vertexpool
@@ -158,6 +419,70 @@ void update(ivec2, Vertexpool<Vertex>&);  //Update Vertexpool at Position (No Re
 void update(Vertexpool<Vertex>&);         //Update Vertexpool at Position (No Remesh)
 void slice(Vertexpool<Vertex>&, double);         //Update Vertexpool at Position (No Remesh)
 
+//Dirty-Cell Tracking
+bool* dirty = NULL;                       //Cell Modified since Last Flush
+vector<int> marked;                       //Indices of Modified Cells
+void mark(ivec2 pos){                     //Mark Cell for Vertexpool Update
+  const int ind = pos.x*dim.y+pos.y;
+  if(dirty[ind]) return;
+  dirty[ind] = true;
+  #ifdef _OPENMP
+  if(omp_in_parallel()){                  //Cells are Owned by a Single Thread
+    const size_t t = omp_get_thread_num();
+    if(t < markedthread.size()){
+      markedthread[t].push_back(ind);
+      return;
+    }
+    std::lock_guard<std::mutex> guard(marklock);
+    marked.push_back(ind);
+    return;
+  }
+  #endif
+  marked.push_back(ind);
+}
+#ifdef _OPENMP
+vector<vector<int>> markedthread = vector<vector<int>>(omp_get_num_procs());
+std::mutex marklock;
+#endif
+
+//Active-Set Tracking (Groundwater)
+bool* active = NULL;                      //Column may Seep (Water Added)
+vector<int> activated;                    //Indices of Active Columns
+void activate(ivec2 pos){                 //Mark Column for Seeping
+  const int ind = pos.x*dim.y+pos.y;
+  if(active[ind]) return;
+  active[ind] = true;
+  #ifdef _OPENMP
+  if(omp_in_parallel()){                  //Cells are Owned by a Single Thread
+    const size_t t = omp_get_thread_num();
+    if(t < activatedthread.size()){
+      activatedthread[t].push_back(ind);
+      return;
+    }
+    std::lock_guard<std::mutex> guard(marklock);
+    activated.push_back(ind);
+    return;
+  }
+  #endif
+  activated.push_back(ind);
+}
+#ifdef _OPENMP
+vector<vector<int>> activatedthread = vector<vector<int>>(omp_get_num_procs());
+#endif
+void gather(){                            //Collect Thread-Local Marks
+  #ifdef _OPENMP
+  for(auto& m: markedthread){
+    marked.insert(marked.end(), m.begin(), m.end());
+    m.clear();
+  }
+  for(auto& a: activatedthread){
+    activated.insert(activated.end(), a.begin(), a.end());
+    a.clear();
+  }
+  #endif
+}
+void flush(Vertexpool<Vertex>&);          //Update Vertexpool at Marked Positions
+
 public:
 
 void initialize(int SEED, ivec2 _dim){
@@ -169,11 +494,48 @@ void initialize(int SEED, ivec2 _dim){
   pool.reset();
 
   if(dat != NULL) delete[] dat;
+
+  #ifdef SOILMACHINE_COLUMNS
+  dat = new vector<sec>[dim.x*dim.y];       //Array of Empty Columns
+  for(int i = 0; i < dim.x*dim.y; i++)      //Allocate in Cell Order
+    dat[i].reserve(layers.size()+2);
+  #else
   dat = new sec*[dim.x*dim.y];      //Array of Section Pointers
 
   for(int i = 0; i < dim.x; i++)
   for(int j = 0; j < dim.y; j++)
     dat[i*dim.y+j] = NULL;
+  #endif
+
+  if(dirty != NULL) delete[] dirty;
+  dirty = new bool[dim.x*dim.y]{false};
+  marked.clear();
+  #ifdef _OPENMP
+  for(auto& m: markedthread)
+    m.clear();
+  for(auto& a: activatedthread)
+    a.clear();
+  #endif
+
+  if(active != NULL) delete[] active;   //Seep Everything Once
+  active = new bool[dim.x*dim.y];
+  activated.resize(dim.x*dim.y);
+  for(int i = 0; i < dim.x*dim.y; i++){
+    active[i] = true;
+    activated[i] = i;
+  }
+
+  if(heights != NULL) delete[] heights;
+  heights = new double[dim.x*dim.y]{0.0};
+  if(normals != NULL) delete[] normals;
+  normals = new vec3[dim.x*dim.y];
+  if(stale != NULL) delete[] stale;
+  stale = new bool[dim.x*dim.y];
+  for(int i = 0; i < dim.x*dim.y; i++)
+    stale[i] = true;
+
+  if(surfaces != NULL) delete[] surfaces;
+  surfaces = new SurfType[dim.x*dim.y]{0};
 
   //Fill 'er up
 
@@ -217,7 +579,11 @@ void initialize(int SEED, ivec2 _dim){
 
 //Constructors
 Layermap(int SEED, ivec2 _dim){
+  #ifdef SOILMACHINE_COLUMNS
+  pool.reserve(1024);                    //Only Holds Elements in Transit
+  #else
   pool.reserve(POOLSIZE);                //Some permissible amount of RAM later...
+  #endif
   initialize(SEED, _dim);
 }
 
@@ -227,6 +593,84 @@ Layermap(int SEED, ivec2 _dim, Vertexpool<Vertex>& vertexpool):Layermap(SEED, _d
 
 };
 
+/*
+================================================================================
+                  Column Primitives (Storage Layout Specific)
+================================================================================
+*/
+
+#ifdef SOILMACHINE_COLUMNS
+
+void Layermap::push(ivec2 pos, sec* E){
+
+  vector<sec>& column = dat[pos.x*dim.y+pos.y];
+  const sec* data = column.data();
+
+  column.push_back(*E);
+  pool.unget(E);
+
+  const size_t n = column.size();
+  sec& T = column.back();
+  T.next = NULL;
+  T.prev = (n > 1) ? &column[n-2] : NULL;
+
+  //Reallocated: Re-Link the Column
+  if(column.data() != data){
+    for(size_t k = 0; k < n; k++){
+      column[k].prev = (k > 0) ? &column[k-1] : NULL;
+      column[k].next = (k+1 < n) ? &column[k+1] : NULL;
+    }
+  }
+  else if(n > 1)
+    column[n-2].next = &T;
+
+}
+
+void Layermap::pop(ivec2 pos){
+  vector<sec>& column = dat[pos.x*dim.y+pos.y];
+  column.pop_back();
+  if(!column.empty())
+    column.back().next = NULL;
+}
+
+sec* Layermap::lift(ivec2 pos){
+  sec* E = pool.get(dat[pos.x*dim.y+pos.y].back());
+  E->next = NULL;
+  E->prev = NULL;
+  pop(pos);
+  return E;
+}
+
+#else
+
+void Layermap::push(ivec2 pos, sec* E){
+  sec* top = dat[pos.x*dim.y+pos.y];
+  E->prev = top;
+  E->next = NULL;
+  if(top != NULL) top->next = E;
+  dat[pos.x*dim.y+pos.y] = E;
+}
+
+void Layermap::pop(ivec2 pos){
+  pool.unget(lift(pos));
+}
+
+sec* Layermap::lift(ivec2 pos){
+  sec* E = dat[pos.x*dim.y+pos.y];
+  dat[pos.x*dim.y+pos.y] = E->prev; //May be NULL
+  if(E->prev != NULL) E->prev->next = NULL;
+  E->prev = NULL;
+  return E;
+}
+
+#endif
+
+/*
+================================================================================
+                          Layermap Modification
+================================================================================
+*/
+
 void Layermap::add(ivec2 pos, sec* E){
 
   //Non-Element: Don't Add
@@ -239,15 +683,26 @@ void Layermap::add(ivec2 pos, sec* E){
     return;
   }
 
+  mark(pos);
+  invalidate(pos);
+  if(E->type == surf.air)
+    activate(pos);
+
+  sec* T = top(pos);
+  const int ind = pos.x*dim.y+pos.y;
+
   //Valid Element, Empty Spot: Set Top Directly
-  if(dat[pos.x*dim.y+pos.y] == NULL){
-    dat[pos.x*dim.y+pos.y] = E;
+  if(T == NULL){
+    heights[ind] = E->size;
+    surfaces[ind] = E->type;
+    push(pos, E);
     return;
   }
 
   //Valid Element, Previous Type Identical: Elongate
-  if(dat[pos.x*dim.y+pos.y]->type == E->type){
-    dat[pos.x*dim.y+pos.y]->size += E->size;
+  if(T->type == E->type){
+    T->size += E->size;
+    heights[ind] += E->size;
     pool.unget(E);
     return;
   }
@@ -255,69 +710,48 @@ void Layermap::add(ivec2 pos, sec* E){
   //Basically: A position Swap
 
   //Add to Water, but not equal to water
-  if(dat[pos.x*dim.y+pos.y]->type == soilmap["Air"]){ //Switch with Water
-
-  //  pool.unget(E);
+  if(T->type == surf.air){ //Switch with Water
 
     //Remove Top Element (Water)
-    sec* top = dat[pos.x*dim.y+pos.y];
-    dat[pos.x*dim.y+pos.y] = top->prev;
+    heights[ind] -= T->size;
+    sec* water = lift(pos);
+    sync(pos);
 
     //Add this Element
     add(pos, E);
 
     //Add Water Back In
-    add(pos, top);
-
+    add(pos, water);
 
     return;
 
   }
 
-  /*
-  if(dat[pos.x*dim.y+pos.y]->prev != NULL)
-  if(dat[pos.x*dim.y+pos.y]->prev->size < 0.01)
-  if(dat[pos.x*dim.y+pos.y]->prev->type == E->type){    //Same Type: Make Taller, Remove E
-    dat[pos.x*dim.y+pos.y]->prev->size += E->size;
-    dat[pos.x*dim.y+pos.y]->floor += E->size;
-    pool.unget(E);
-    return;
-  }
-  */
-
-  //Try a sorting move???
-
-  /*
-  if(dat[pos.x*dim.y+pos.y]->prev != NULL)
-  if(soils[dat[pos.x*dim.y+pos.y]->type].density < soils[E->type].density)
-  if(dat[pos.x*dim.y+pos.y]->prev->type == E->type){    //Same Type: Make Taller, Remove E
-    dat[pos.x*dim.y+pos.y]->prev->size += E->size;
-    dat[pos.x*dim.y+pos.y]->floor += E->size;
-    pool.unget(E);
-    return;
-  }
-  */
-
   //Add Element
-  dat[pos.x*dim.y+pos.y]->next = E;
-  E->prev = dat[pos.x*dim.y+pos.y];
-  E->floor = height(pos);
-  dat[pos.x*dim.y+pos.y] = E;
+  heights[ind] += E->size;
+  surfaces[ind] = E->type;
+  push(pos, E);
 
 }
 
 //Returns Amount Removed
 double Layermap::remove(ivec2 pos, double h){
 
+  sec* T = top(pos);
+
   //No Element to Remove
-  if(dat[pos.x*dim.y+pos.y] == NULL)
+  if(T == NULL)
     return 0.0;
 
+  const int ind = pos.x*dim.y+pos.y;
+
   //Element Needs Removal
-  if(dat[pos.x*dim.y+pos.y]->size <= 0.0){
-    sec* E = dat[pos.x*dim.y+pos.y];
-    dat[pos.x*dim.y+pos.y] = E->prev; //May be NULL
-    pool.unget(E);
+  if(T->size <= 0.0){
+    mark(pos);
+    invalidate(pos);
+    heights[ind] -= T->size;
+    pop(pos);
+    sync(pos);
     return 0.0;
   }
 
@@ -325,20 +759,137 @@ double Layermap::remove(ivec2 pos, double h){
   if(h <= 0.0)
     return 0.0;
 
-  double diff = h - dat[pos.x*dim.y+pos.y]->size;
-  dat[pos.x*dim.y+pos.y]->size -= h;
+  mark(pos);
+  invalidate(pos);
+
+  double diff = h - T->size;
 
   if(diff >= 0.0){
-    sec* E = dat[pos.x*dim.y+pos.y];
-    dat[pos.x*dim.y+pos.y] = E->prev; //May be NULL
-    pool.unget(E);
+    heights[ind] -= T->size;
+    pop(pos);
+    sync(pos);
     return diff;
   }
-  else return 0.0;
+
+  T->size -= h;
+  heights[ind] -= h;
+  return 0.0;
+
+}
+
+/*
+================================================================================
+                        Layer Compaction / Defragmentation
+================================================================================
+
+Adjacent runs of identical type are merged, runs thinner than epsilon are folded
+into the run below them (or above, at the bottom), conserving the column height.
+Optionally, all columns are re-allocated in grid order so that each column's
+elements are contiguous in the pool.
+
+*/
+
+int Layermap::compact(ivec2 pos, double epsilon){
+
+  static vector<sec> column;                //Bottom First
+  column.clear();
+  int n = 0;
+
+  for(sec* T = top(pos); T != NULL; T = T->prev, n++)
+    column.push_back(*T);
+  reverse(column.begin(), column.end());
+
+  int k = 0;
+  for(auto& c: column){
+
+    sec* B = (k > 0) ? &column[k-1] : NULL;
+
+    //Absorb into Run Below
+    if(B != NULL && (B->type == c.type || c.size < epsilon)){
+      double size = B->size + c.size;
+      if(size > 0) B->saturation = (B->saturation*B->size + c.saturation*c.size)/size;
+      B->size = size;
+      continue;
+    }
+
+    //Run Below is Too Thin: Absorb it
+    if(B != NULL && B->size < epsilon){
+      double size = B->size + c.size;
+      if(size > 0) c.saturation = (B->saturation*B->size + c.saturation*c.size)/size;
+      c.size = size;
+      column[k-1] = c;
+      continue;
+    }
+
+    column[k++] = c;
+
+  }
+
+  if(k == n)
+    return 0;
+
+  while(top(pos) != NULL)
+    pop(pos);
+  for(int i = 0; i < k; i++)
+    push(pos, pool.get(column[i]));
+
+  mark(pos);
+  activate(pos);                  //Saturation was Averaged
+  restack(pos);
+  return n - k;
+
+}
+
+int Layermap::compact(double epsilon = 1E-6, bool relocate = false){
+
+  int reclaimed = 0;
+  for(int i = 0; i < dim.x; i++)
+  for(int j = 0; j < dim.y; j++)
+    reclaimed += compact(ivec2(i, j), epsilon);
+
+  #ifndef SOILMACHINE_COLUMNS     //Columns are Already Contiguous
+
+  if(relocate){
+
+    vector<sec> all;                        //All Elements, Grid Order, Bottom First
+    vector<int> count(dim.x*dim.y, 0);
+
+    for(int i = 0; i < dim.x*dim.y; i++){
+      const size_t begin = all.size();
+      for(sec* T = dat[i]; T != NULL; T = T->prev, count[i]++)
+        all.push_back(*T);
+      reverse(all.begin()+begin, all.end());
+      dat[i] = NULL;
+    }
+
+    const int peak = pool.peak;
+    pool.reset();                           //Free Elements in Address Order
+    pool.peak = peak;
+
+    size_t k = 0;
+    for(int i = 0; i < dim.x; i++)
+    for(int j = 0; j < dim.y; j++)
+    for(int c = 0; c < count[i*dim.y+j]; c++)
+      push(ivec2(i, j), pool.get(all[k++]));
+
+  }
+
+  #endif
+
+  return reclaimed;
 
 }
 
 vec3 Layermap::normal(ivec2 pos){
+  const int ind = pos.x*dim.y+pos.y;
+  if(stale[ind]){
+    normals[ind] = computenormal(pos);
+    stale[ind] = false;
+  }
+  return normals[ind];
+}
+
+vec3 Layermap::computenormal(ivec2 pos){
 
   vec3 n = vec3(0);
   vec3 p = vec3(pos.x, SCALE*height(pos), pos.y);
@@ -414,14 +965,60 @@ vec3 Layermap::normal(vec2 pos, Vertexpool<Vertex>& vertexpool){
 
 //Queries
 
+void Layermap::sync(ivec2 pos){
+  sec* T = top(pos);
+  surfaces[pos.x*dim.y+pos.y] = (T == NULL) ? 0 : T->type;
+  if(T == NULL) heights[pos.x*dim.y+pos.y] = 0.0;   //Exactly Zero
+}
+
+void Layermap::restack(ivec2 pos){
+  double h = 0.0;
+  for(sec* T = top(pos); T != NULL; T = T->prev)
+    h += T->size;
+  heights[pos.x*dim.y+pos.y] = h;
+  invalidate(pos);
+  sync(pos);
+}
+
+void Layermap::shrink(ivec2 pos, sec* E, double h){
+
+  if(E == top(pos)){
+    remove(pos, h);
+    return;
+  }
+
+  //Interior Element: Floors Above Shift, Column Height Re-Derived
+  E->size -= h;
+  if(E->size < 0.0) E->size = 0.0;      //Dropped on Compaction
+  mark(pos);
+  restack(pos);
+
+}
+
+double Layermap::standing(ivec2 pos){
+  sec* T = top(pos);
+  return (T != NULL && T->type == surf.air) ? (double)T->size : 0.0;
+}
+
+void Layermap::standing(ivec2 pos, double w){
+
+  const double d = w - standing(pos);
+
+  if(d > MINWATER){
+    add(pos, pool.get(d, surf.air));
+    top(pos)->saturation = 1.0f;
+  }
+  else if(d < -MINWATER || (w < MINWATER && d < 0.0))
+    remove(pos, -d);
+
+}
+
 SurfType Layermap::surface(ivec2 pos){
-  if(dat[pos.x*dim.y+pos.y] == NULL) return 0;
-  return dat[pos.x*dim.y+pos.y]->type;
+  return surfaces[pos.x*dim.y+pos.y];
 }
 
 double Layermap::height(ivec2 pos){
-  if(dat[pos.x*dim.y+pos.y] == NULL) return 0.0;
-  return (dat[pos.x*dim.y+pos.y]->floor + dat[pos.x*dim.y+pos.y]->size);
+  return heights[pos.x*dim.y+pos.y];
 }
 
 double Layermap::height(vec2 pos){
@@ -430,10 +1027,12 @@ double Layermap::height(vec2 pos){
   ivec2 p = floor(pos);
   vec2 w = fract(pos);
 
-  h += (1.0-w.x)*(1.0-w.y)*height(p);
-  h += (1.0-w.x)*w.y*height(p+ivec2(1,0));
-  h += w.x*(1.0-w.y)*height(p+ivec2(0,1));
-  h += w.x*w.y*height(p+ivec2(1,1));
+  const double* H = heights + p.x*dim.y+p.y;    //2x2 Block: H[0], H[1], H[dim.y], H[dim.y+1]
+
+  h += (1.0-w.x)*(1.0-w.y)*H[0];
+  h += (1.0-w.x)*w.y*H[dim.y];
+  h += w.x*(1.0-w.y)*H[1];
+  h += w.x*w.y*H[dim.y+1];
   return h;
 
 }
@@ -453,6 +1052,11 @@ void Layermap::meshpool(Vertexpool<Vertex>& vertexpool){
   for(int j = 0; j < dim.y; j++)
     update(ivec2(i,j), vertexpool);
 
+  gather();
+  for(auto& ind: marked)                  //Everything is Up-To-Date
+    dirty[ind] = false;
+  marked.clear();
+
   for(int i = 0; i < dim.x-1; i++){
   for(int j = 0; j < dim.y-1; j++){
 
@@ -474,9 +1078,12 @@ void Layermap::meshpool(Vertexpool<Vertex>& vertexpool){
 
 void Layermap::update(ivec2 p, Vertexpool<Vertex>& vertexpool){
 
-  sec* top = dat[p.x*dim.y+p.y];
-  while(top != NULL && top->floor > (float)SLICE/(float)SCALE)
+  sec* top = this->top(p);
+  double floor = (top == NULL) ? 0.0 : height(p) - top->size;
+  while(top != NULL && floor > (float)SLICE/(float)SCALE){
     top = top->prev;
+    if(top != NULL) floor -= top->size;
+  }
 
   if(top == NULL){
     vertexpool.fill(section, p.x*dim.y+p.y,
@@ -487,9 +1094,9 @@ void Layermap::update(ivec2 p, Vertexpool<Vertex>& vertexpool){
     );
   }
 
-  else if(top->floor + top->size > (float)SLICE/(float)SCALE){
+  else if(floor + top->size > (float)SLICE/(float)SCALE){
 
-    if(top->floor + top->size*top->saturation > (float)SLICE/(float)SCALE)
+    if(floor + top->size*top->saturation > (float)SLICE/(float)SCALE)
     vertexpool.fill(section, p.x*dim.y+p.y,
       vec3(p.x, SLICE, p.y),
       vec3(0,1,0),
@@ -514,14 +1121,14 @@ void Layermap::update(ivec2 p, Vertexpool<Vertex>& vertexpool){
 /*
     if(top->saturation == 1)  //Fill Watertable!
     vertexpool.fill(section, p.x*dim.y+p.y,
-      vec3(p.x, SCALE*(top->floor + top->size), p.y),
+      vec3(p.x, SCALE*(floor + top->size), p.y),
       normal(p),
       soils[soilmap["Air"]].color
     );
 */
 //    else
     vertexpool.fill(section, p.x*dim.y+p.y,
-      vec3(p.x, SCALE*(top->floor + top->size), p.y),
+      vec3(p.x, SCALE*(floor + top->size), p.y),
       normal(p),
       soils[top->type].color,
       top->type
@@ -554,6 +1161,15 @@ void Layermap::update(Vertexpool<Vertex>& vertexpool){
     update(ivec2(i,j), vertexpool);
 }
 
+void Layermap::flush(Vertexpool<Vertex>& vertexpool){
+  gather();
+  for(auto& ind: marked){
+    update(ivec2(ind/dim.y, ind%dim.y), vertexpool);
+    dirty[ind] = false;
+  }
+  marked.clear();
+}
+
 void Layermap::slice(Vertexpool<Vertex>& vertexpool, double s = SCALE){
 
   for(int i = 0; i < dim.x; i++)
@@ -562,9 +1178,12 @@ void Layermap::slice(Vertexpool<Vertex>& vertexpool, double s = SCALE){
     ivec2 p = ivec2(i,j);
 
     //Find the first element which starts below the scale!
-    sec* top = dat[p.x*dim.y+p.y];
-    while(top != NULL && top->floor > s/SCALE)
+    sec* top = this->top(p);
+    double floor = (top == NULL) ? 0.0 : height(p) - top->size;
+    while(top != NULL && floor > s/SCALE){
       top = top->prev;
+      if(top != NULL) floor -= top->size;
+    }
 
     if(top == NULL){
       vertexpool.fill(section, p.x*dim.y+p.y,
@@ -575,8 +1194,8 @@ void Layermap::slice(Vertexpool<Vertex>& vertexpool, double s = SCALE){
       );
     }
 
-    else if(top->floor + top->size > s/SCALE){
-      if(top->floor + top->size*top->saturation > s/SCALE)
+    else if(floor + top->size > s/SCALE){
+      if(floor + top->size*top->saturation > s/SCALE)
       vertexpool.fill(section, p.x*dim.y+p.y,
         vec3(p.x, s, p.y),
         vec3(0,1,0),
@@ -595,14 +1214,14 @@ void Layermap::slice(Vertexpool<Vertex>& vertexpool, double s = SCALE){
     else{
       if(top->saturation == 0)  //Fill Watertable!
       vertexpool.fill(section, p.x*dim.y+p.y,
-        vec3(p.x, SCALE*(top->floor + top->size), p.y),
+        vec3(p.x, SCALE*(floor + top->size), p.y),
         normal(p),
         vec4(1,0,0,1),
         top->type
       );
       else
       vertexpool.fill(section, p.x*dim.y+p.y,
-        vec3(p.x, SCALE*(top->floor + top->size), p.y),
+        vec3(p.x, SCALE*(floor + top->size), p.y),
         normal(p),
         soils[top->type].color,
         top->type
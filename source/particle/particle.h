@@ -8,20 +8,51 @@
 #define LAYEREDEROSION_PARTICLE
 
 #include "../include/distribution.h"
+#include <atomic>
 
 using namespace glm;
 
+//Random Number Streams
+enum Stream {
+  WATERSPAWN,
+  WINDSPAWN
+};
+
 struct Particle {
 
   vec2 pos;
   vec2 speed = vec2(0);
   bool isalive = true;
 
+  //Spawn Position of the i-th Particle in a Cycle (Independent of Order)
+  static vec2 spawn(ivec2 dim, Stream stream, uint64_t cycle, uint64_t i){
+    const uint64_t h = dist::hash(SEED, stream, (cycle << 32) | i);
+    return vec2((h >> 32)%dim.x, (h & 0xFFFFFFFF)%dim.y);
+  }
+
   bool move(Layermap& map);
-  bool interact(Layermap& map, Vertexpool<Vertex>& vertexpool);
+  bool interact(Layermap& map);
+
+  //Grayscale Texel (Packed ABGR8888, i.e. RGBA Bytes on Little-Endian)
+  static uint32_t texel(float f){
+    int v = 255.0f*f;                         //Frequencies are in [0, 1]
+    v = (v < 0) ? 0 : (v > 255) ? 255 : v;    //Integer Clamp (Vectorizes)
+    return 0xFF000000u | (uint32_t)v*0x010101u;
+  }
+
+  //Lock-Free Update of a Shared Map Value (Concurrent Particles)
+  template<typename F>
+  static void atomically(float& value, F f){
+    std::atomic_ref<float> a(value);
+    float v = a.load(std::memory_order_relaxed);
+    while(!a.compare_exchange_weak(v, f(v), std::memory_order_relaxed));
+  }
 
   //This is applied to multiple types of erosion, so I put it in here!
-  static void cascade(vec2 pos, Layermap& map, Vertexpool<Vertex>& vertexpool, int transferloop = 0){
+  static void cascade(vec2 pos, Layermap& map, int transferloop = 0){
+
+    if(!surf.cascading)                 //No Soil Settles
+      return;
 
     ivec2 ipos = round(pos);
 
@@ -72,15 +103,14 @@ struct Particle {
       ivec2 bpos = (diff > 0) ? npos : ipos;
 
       SurfType type = map.surface(tpos);
-      SurfParam param = soils[type];
 
       //The Amount of Excess Difference!
-      float excess = abs(diff) - param.maxdiff;
+      float excess = abs(diff) - surf.maxdiff[type];
       if(excess <= 0)  //No Excess
         continue;
 
       //Actual Amount Transferred
-      float transfer = param.settling * excess / 2.0f;
+      float transfer = surf.settling[type] * excess / 2.0f;
 
       bool recascade = false;
 
@@ -89,12 +119,10 @@ struct Particle {
 
       if(map.remove(tpos, transfer) != 0)
         recascade = true;
-      map.add(bpos, map.pool.get(transfer, param.cascades));
-      map.update(tpos, vertexpool);
-      map.update(bpos, vertexpool);
+      map.add(bpos, map.pool.get(transfer, surf.cascades[type]));
 
       if(recascade && transferloop > 0)
-        cascade(npos, map, vertexpool, --transferloop);
+        cascade(npos, map, --transferloop);
 
     }
 
@@ -8,13 +8,15 @@
 
 struct WaterParticle : public Particle {
 
-  WaterParticle(Layermap& map){
+  WaterParticle(Layermap& map, uint64_t cycle, uint64_t i):
+    WaterParticle(map, spawn(map.dim, WATERSPAWN, cycle, i)){}
 
-    pos = vec2(rand()%map.dim.x, rand()%map.dim.y);
+  WaterParticle(Layermap& map, vec2 _pos){
+
+    pos = _pos;
     ipos = round(pos);
     surface = map.surface(ipos);
-    param = soils[surface];
-    contains = param.transports;    //The Transporting Type
+    contains = surf.transports[surface];  //The Transporting Type
 
   }
 
@@ -36,28 +38,26 @@ struct WaterParticle : public Particle {
   //Helper Properties
   ivec2 ipos;
   vec3 n;
-  SurfParam param;
   SurfType surface;
   SurfType contains;
 
-  bool move(Layermap& map, Vertexpool<Vertex>& vertexpool){
+  bool move(Layermap& map){
 
     ipos = round(pos);                //Position
     n = map.normal(ipos);             //Surface Normal Vector
     surface = map.surface(ipos);      //Surface Composition
-    param = soils[surface];           //Surface Composition
     evaprate = 0.01;                 //Reset Evaprate
     updatefrequency(map, ipos);
 
     //Modify Parameters Based on Frequency
-    param.friction = param.friction*(1.0f-frequency[ipos.y*map.dim.x+ipos.x]);
+    const float friction = surf.friction[surface]*(1.0f-frequency[ipos.y*map.dim.x+ipos.x]);
     evaprate = evaprate*(1.0f-0.2f*frequency[ipos.y*map.dim.x+ipos.x]);
 
-    if(length(vec2(n.x, n.z)*param.friction) < 1E-5)   //No Motion
+    if(length(vec2(n.x, n.z)*friction) < 1E-5)   //No Motion
       return false;
 
     //Motion Low
-    speed = mix(vec2(n.x, n.z), speed, param.friction);
+    speed = mix(vec2(n.x, n.z), speed, friction);
     speed = sqrt(2.0f)*normalize(speed);
     pos   += speed;
 
@@ -72,16 +72,123 @@ struct WaterParticle : public Particle {
 
   }
 
-  bool interact(Layermap& map, Vertexpool<Vertex>& vertexpool){
+  /*
+    Packet Mode: Moves up to PACKET particles in lockstep. The particle state is
+    gathered into a structure of arrays, so that the step is a single (omp simd)
+    loop over lanes, reading the dense height, surface and frequency planes.
+    Stopped and dead lanes are masked. Frequency tracking is applied per particle
+    afterwards.
+  */
+
+  static const int PACKET = 16;
+
+  struct Packet {
+    int n = 0;                            //Occupied Lanes
+    WaterParticle* particle[PACKET];
+    float px[PACKET], py[PACKET];         //Position (In)
+    float sx[PACKET], sy[PACKET];         //Speed (In)
+    float qx[PACKET], qy[PACKET];         //Position (Out)
+    float vx[PACKET], vy[PACKET];         //Speed (Out)
+    float nx[PACKET], ny[PACKET], nz[PACKET];
+    float evaprate[PACKET];
+    int x[PACKET], y[PACKET];             //Rounded Position
+    int moved[PACKET];                    //Lane Masks (Int, so the Loop Vectorizes)
+    int inside[PACKET];
+  };
+
+  static void move(Layermap& map, Packet& P){
+
+    const double* H = map.heightmap();
+    const SurfType* S = map.surfacemap();
+    const float* F = frequency;
+    const int X = map.dim.x;
+    const int Y = map.dim.y;
+    const float scale = SCALE;
+    const float* friction = &surf.friction[0];
+
+    for(int k = 0; k < P.n; k++){
+      P.px[k] = P.particle[k]->pos.x;
+      P.py[k] = P.particle[k]->pos.y;
+      P.sx[k] = P.particle[k]->speed.x;
+      P.sy[k] = P.particle[k]->speed.y;
+    }
+
+    #pragma omp simd
+    for(int k = 0; k < P.n; k++){
+
+      const int x = P.px[k] + 0.5f;
+      const int y = P.py[k] + 0.5f;
+      const int c = x*Y+y;
+
+      //Normal from the Height Plane (Closed Form of Layermap::normal)
+      const int xl = x > 0, xh = x < X-1;   //Neighbors Inside, Else Clamped
+      const int yl = y > 0, yh = y < Y-1;
+      const float dx = scale*(float)(H[c-xl*Y] - H[c+xh*Y]);
+      const float dz = scale*(float)(H[c-yl] - H[c+yh]);
+      const float kx = xl + xh;
+      const float ky = yl + yh;
+      float nx = ky*dx, ny = kx*ky, nz = kx*dz;
+      const float nl = 1.0f/sqrt(nx*nx + ny*ny + nz*nz);
+      nx *= nl; ny *= nl; nz *= nl;
+
+      const float f = F[y*X+x];
+      const int s = S[c];                 //32-Bit Index for the Gather
+      const float fr = friction[s]*(1.0f-f);
+
+      P.x[k] = x;
+      P.y[k] = y;
+      P.nx[k] = nx;
+      P.ny[k] = ny;
+      P.nz[k] = nz;
+      P.evaprate[k] = 0.01f*(1.0f-0.2f*f);
+
+      //No Motion
+      const int moved = (fr*fr*(nx*nx + nz*nz) >= 1E-10f);
+      P.moved[k] = moved;
+
+      float sx = nx*(1.0f-fr) + P.sx[k]*fr;
+      float sy = nz*(1.0f-fr) + P.sy[k]*fr;
+      const float sl = sqrt(2.0f)/sqrt(sx*sx + sy*sy);
+      sx *= sl; sy *= sl;
+
+      const float px = P.px[k] + sx;
+      const float py = P.py[k] + sy;
+      P.inside[k] = (px >= 0.0f) & (py >= 0.0f) & (px < X-1.0f) & (py < Y-1.0f);
+
+      P.vx[k] = moved ? sx : P.sx[k];
+      P.vy[k] = moved ? sy : P.sy[k];
+      P.qx[k] = moved ? px : P.px[k];
+      P.qy[k] = moved ? py : P.py[k];
+
+    }
+
+    for(int k = 0; k < P.n; k++){
+      WaterParticle& particle = *P.particle[k];
+      particle.ipos = ivec2(P.x[k], P.y[k]);
+      particle.n = vec3(P.nx[k], P.ny[k], P.nz[k]);
+      particle.surface = S[P.x[k]*Y+P.y[k]];
+      particle.evaprate = P.evaprate[k];
+      particle.updatefrequency(map, particle.ipos);
+      particle.pos = vec2(P.qx[k], P.qy[k]);
+      particle.speed = vec2(P.vx[k], P.vy[k]);
+      if(P.moved[k] && !P.inside[k]){     //Out-of-Bounds
+        particle.volume = 0.0;
+        P.moved[k] = false;
+      }
+    }
+
+  }
+
+  bool interact(Layermap& map){
 
     //Equilibrium Sediment Transport Amount
-    double c_eq = param.solubility*(map.height(ipos)-map.height(pos))*(double)SCALE/80.0;
+    double c_eq = surf.solubility[surface]*(map.height(ipos)-map.height(pos))*(double)SCALE/80.0;
     if(c_eq < 0.0) c_eq = 0.0;
     if(c_eq > 1.0) c_eq = 1.0;
 
     //Erode Sediment IN Particle
-    if((double)(soils[contains].erosionrate) < frequency[ipos.y*map.dim.x+ipos.x])
-      contains = soils[contains].erodes;
+    if(surf.converting && (double)(surf.erosionrate[contains]) < frequency[ipos.y*map.dim.x+ipos.x])
+      contains = surf.erodes[contains];
 
     //Execute Transport to Particle
     double cdiff = c_eq - sediment;
@@ -90,10 +197,11 @@ struct WaterParticle : public Particle {
 
     if(cdiff > 0) {
 
-      sediment += param.equrate*cdiff;
-      contains = soils[map.surface(ipos)].transports;
+      const float equrate = surf.equrate[surface];
+      sediment += equrate*cdiff;
+      contains = surf.transports[map.surface(ipos)];
   //    if(volume > 1) volume = 1;
-      double diff = map.remove(ipos, param.equrate*cdiff*volume);
+      double diff = map.remove(ipos, equrate*cdiff*volume);
       while(abs(diff) > 1E-8){
         diff = map.remove(ipos, diff);
       }
@@ -104,13 +212,13 @@ struct WaterParticle : public Particle {
 
     else if(cdiff < 0) {
 
-      sediment += soils[contains].equrate*cdiff;
-      map.add(ipos, map.pool.get(-soils[contains].equrate*cdiff*volume, contains));
+      sediment += surf.equrate[contains]*cdiff;
+      map.add(ipos, map.pool.get(-surf.equrate[contains]*cdiff*volume, contains));
 
     }
 
     //Particle Cascade: Thermal Erosion!
-    Particle::cascade(pos, map, vertexpool, 0);
+    Particle::cascade(pos, map, 0);
 
     //Update Map, Particle
     sediment /= (1.0-evaprate);
@@ -120,7 +228,7 @@ struct WaterParticle : public Particle {
 
   }
 
-  bool flood(Layermap& map, Vertexpool<Vertex>& vertexpool){
+  bool flood(Layermap& map){
 
     if(volume < minvol || spill-- <= 0)
       return false;
@@ -130,16 +238,15 @@ struct WaterParticle : public Particle {
 
     // Add Remaining Soil
 
-    map.add(ipos, map.pool.get(sediment*soils[contains].equrate, contains));
-    Particle::cascade(pos, map, vertexpool, 0);
+    map.add(ipos, map.pool.get(sediment*surf.equrate[contains], contains));
+    Particle::cascade(pos, map, 0);
 
     // Add Water
 
-    map.add(ipos, map.pool.get(volume*volumeFactor, soilmap["Air"]));
-    seep(ipos, map, vertexpool);
-    WaterParticle::cascade(ipos, map, vertexpool, spill);
+    map.add(ipos, map.pool.get(volume*volumeFactor, surf.air));
+    seep(ipos, map);
+    WaterParticle::cascade(ipos, map, spill);
 
-    map.update(ipos, vertexpool);
     return false;
 
   }
@@ -148,44 +255,94 @@ struct WaterParticle : public Particle {
 
 
 
-  static void cascade(vec2 pos, Layermap& map, Vertexpool<Vertex>& vertexpool, int spill = 0){
+  /*
+    Water Cascade: Relaxes the water table of a cell against its neighbors,
+    highest first. Instead of recursing, cells to relax are frames on an
+    explicit work list, processed depth-first: a frame which requests a nested
+    cascade pushes it and resumes at its next neighbor once the nested frame
+    is done. Cascades requested by the floods of spill particles simulated
+    inline are pushed onto the same list. The order of transfers is that of
+    the recursive formulation, without growing the call stack.
+  */
 
-    ivec2 ipos = pos;
+  struct Point {
+    ivec2 pos;
+    double h;
+  };
 
-    static const ivec2 n[] = {
-      ivec2(-1, -1),
-      ivec2(-1,  0),
-      ivec2(-1,  1),
-      ivec2( 0, -1),
-      ivec2( 0,  1),
-      ivec2( 1, -1),
-      ivec2( 1,  0),
-      ivec2( 1,  1)
-    };
-
-    //No Out-Of-Bounds
-
-    struct Point {
-      ivec2 pos;
-      double h;
-    };
-    Point sn[8];
-    int num = 0;
-    for(auto& nn: n){
-      ivec2 npos = ipos + nn;
-      if(npos.x >= map.dim.x || npos.y >= map.dim.y
-         || npos.x < 0 || npos.y < 0) continue;
-      sn[num++] = { npos, map.height(npos) };
+  struct Relax {
+    ivec2 pos;                    //Cell to Relax
+    int spill;                    //Remaining Spill Depth
+    int num = -1;                 //Number of Neighbors (-1: Not Yet Sorted)
+    int next = 0;                 //Next Neighbor
+    Point sn[8];                  //Neighbors, Highest First
+    Relax(ivec2 _pos, int _spill){
+      pos = _pos;
+      spill = _spill;
     }
+  };
 
-    // Sort by Highest First (Soil is Moved Down After All)
+  static void cascade(vec2 pos, Layermap& map, int spill = 0){
 
-    sort(std::begin(sn), std::begin(sn) + num, [&](const Point& a, const Point& b){
-      return a.h > b.h;
-    });
+    if(relaxing != NULL){         //Requested from within the Work List
+      relaxing->push_back({ivec2(pos), spill});
+      maxdepth = std::max(maxdepth, (int)relaxing->size());
+      return;
+    }
+
+    static thread_local vector<Relax> work;   //Reused, Empty when Idle
+    relaxing = &work;
+    work.push_back({ivec2(pos), spill});
+    maxdepth = std::max(maxdepth, 1);
+
+    while(!work.empty())
+      relax(work, map);
+
+    relaxing = NULL;
+
+  }
+
+  //Relax the Top Frame until it is Done or Pushes a Nested Frame
+  static void relax(vector<Relax>& work, Layermap& map){
+
+    const size_t k = work.size()-1;     //Frame Index (References Invalidate on Push)
+
+    if(work[k].num < 0){
+
+      static const ivec2 n[] = {
+        ivec2(-1, -1),
+        ivec2(-1,  0),
+        ivec2(-1,  1),
+        ivec2( 0, -1),
+        ivec2( 0,  1),
+        ivec2( 1, -1),
+        ivec2( 1,  0),
+        ivec2( 1,  1)
+      };
+
+      //No Out-Of-Bounds
+
+      Relax& f = work[k];
+      f.num = 0;
+      for(auto& nn: n){
+        ivec2 npos = f.pos + nn;
+        if(npos.x >= map.dim.x || npos.y >= map.dim.y
+           || npos.x < 0 || npos.y < 0) continue;
+        f.sn[f.num++] = { npos, map.height(npos) };
+      }
+
+      // Sort by Highest First (Soil is Moved Down After All)
 
-    for (int i = 0; i < num; ++i) {
-      auto& npos = sn[i].pos;
+      sort(std::begin(f.sn), std::begin(f.sn) + f.num, [&](const Point& a, const Point& b){
+        return a.h > b.h;
+      });
+
+    }
+
+    while(work[k].next < work[k].num){
+
+      const ivec2 ipos = work[k].pos;
+      const ivec2 npos = work[k].sn[work[k].next++].pos;
 
       sec* secA = map.top(ipos);
       sec* secB = map.top(npos);
@@ -193,12 +350,12 @@ struct WaterParticle : public Particle {
       // Water Table Heights
       double whA = 0, whB = 0;
       if(secA != NULL){
-        if(secA->type == soilmap["Air"])
+        if(secA->type == surf.air)
         whA = secA->size;//*soils[secA->type].porosity*secA->saturation;
         else whA = secA->size;
       }
       if(secB != NULL){
-        if(secB->type == soilmap["Air"])
+        if(secB->type == surf.air)
         whB = secB->size;//*soils[secB->type].porosity*secB->saturation;
         else whB = secB->size;
       }
@@ -208,10 +365,10 @@ struct WaterParticle : public Particle {
       double fB = 0.0;
 
       if(secA != NULL)
-        fA = secA->floor;
+        fA = map.height(ipos) - secA->size;
 
       if(secB != NULL)
-        fB = secB->floor;
+        fB = map.height(npos) - secB->size;
 
       // Actual Height Difference Between Watertables
       double diff = (fA + whA - fB - whB)*(double)SCALE/80.0;
@@ -226,7 +383,7 @@ struct WaterParticle : public Particle {
       ivec2 bpos = (diff > 0) ? npos : ipos;
 
       // We are currently only cascading air
-      if(top->type != soilmap["Air"])
+      if(top->type != surf.air)
         continue;
 
       //Maximum Transferrable Amount of Water (Height Difference)
@@ -246,21 +403,25 @@ struct WaterParticle : public Particle {
       if(transfer == wh){
 
         double diff = map.remove(tpos, transfer);
-        map.update(tpos, vertexpool);
 
-        WaterParticle particle(map);
+        WaterParticle particle(map, tpos);
         particle.speed = sqrt(2.0f)*normalize(glm::vec2(bpos)-glm::vec2(tpos));
 
-        particle.pos = tpos;
-        particle.spill = spill;
+        particle.spill = work[k].spill;
         particle.volume = transfer / WaterParticle::volumeFactor;
 
-        while(true){
-          while(particle.move(map, vertexpool) && particle.interact(map, vertexpool));
-          if(!particle.flood(map, vertexpool))
+        if(spawned != NULL)               //Deferred by the Tile Scheduler
+          spawned->push_back(particle);
+
+        else while(true){                 //Floods Push onto the Work List
+          while(particle.move(map) && particle.interact(map));
+          if(!particle.flood(map))
             break;
         }
 
+        if(work.size() > k+1)             //Nested Frames Run First
+          return;
+
       }
 
       else {
@@ -268,43 +429,52 @@ struct WaterParticle : public Particle {
         if(map.remove(tpos, transfer) != 0)
           recascade = true;
         if(transfer > 0) recascade = true;
-        map.add(bpos, map.pool.get(transfer, soilmap["Air"]));
+        map.add(bpos, map.pool.get(transfer, surf.air));
         map.top(bpos)->saturation = 1.0f;
-        map.update(tpos, vertexpool);
-        map.update(bpos, vertexpool);
 
       }
 
-      if(recascade && spill > 0)
-        WaterParticle::cascade(npos, map, vertexpool, --spill);
+      if(recascade && work[k].spill > 0){
+        const int spill = --work[k].spill;
+        work.push_back({npos, spill});
+        maxdepth = std::max(maxdepth, (int)work.size());
+        return;
+      }
 
     }
 
+    work.pop_back();
+
   }
 
-  static void seep(vec2 pos, Layermap& map, Vertexpool<Vertex>& vertexpool){
+  //Returns False at Equilibrium (No Water Moved)
+  static bool seep(vec2 pos, Layermap& map){
+
+    if(!surf.seeping)                   //No Porous Soil
+      return false;
 
     ivec2 ipos = pos;
 
     sec* top = map.top(ipos);
     double pressure = 0.0f;            //Pressure Increases Moving Down
-    if(top == NULL) return;
+    double moved = 0.0;                //Total Transferred Volume
+    if(top == NULL) return false;
 
     while(top != NULL && top->prev != NULL){
 
       sec* prev = top->prev;
 
-      SurfParam param = soils[top->type];
-      SurfParam nparam = soils[prev->type];
+      const float porosity = surf.porosity[top->type];
+      const float nporosity = surf.porosity[prev->type];
 
       // Volume Top Layer
-      double vol = top->size*top->saturation*param.porosity;
+      double vol = top->size*top->saturation*porosity;
 
       //Volume Bottom Layer
-      double nvol = prev->size*prev->saturation*nparam.porosity;
+      double nvol = prev->size*prev->saturation*nporosity;
 
       //Empty Volume Bottom Layer
-      double nevol = prev->size*(1.0 - prev->saturation)*nparam.porosity;
+      double nevol = prev->size*(1.0 - prev->saturation)*nporosity;
 
       double seepage = 1.0;
 
@@ -315,12 +485,14 @@ struct WaterParticle : public Particle {
       if(transfer > 0){
 
         // Remove from Top Layer
-        if(top->type == soilmap["Air"])
-          double diff = map.remove(ipos, seepage*transfer);
+        if(top->type == surf.air)
+          map.shrink(ipos, top, seepage*transfer);
         else
-          top->saturation -= (seepage*transfer) / (top->size*param.porosity);
+          top->saturation -= (seepage*transfer) / (top->size*porosity);
 
-        prev->saturation += (seepage*transfer) / (prev->size*nparam.porosity);
+        prev->saturation += (seepage*transfer) / (prev->size*nporosity);
+        map.mark(ipos);
+        moved += seepage*transfer;
 
       }
 
@@ -328,16 +500,16 @@ struct WaterParticle : public Particle {
 
     }
 
-    map.update(ipos, vertexpool);
+    return moved > 1E-6;
 
   }
 
-  static void seep(Layermap& map, Vertexpool<Vertex>& vertexpool){
+  static void seep(Layermap& map){
 
     for(size_t x = 0; x < map.dim.x; x++)
     for(size_t y = 0; y < map.dim.y; y++){
-      seep(ivec2(x,y), map, vertexpool);
-      WaterParticle::cascade(ivec2(x,y), map, vertexpool, 3);
+      seep(ivec2(x,y), map);
+      WaterParticle::cascade(ivec2(x,y), map, 3);
     }
 
   }
@@ -345,23 +517,40 @@ struct WaterParticle : public Particle {
   static float* frequency;
   static float* track;
 
+  static thread_local vector<WaterParticle>* spawned;   //Spill Particle Queue (NULL: Run Inline)
+  static thread_local vector<Relax>* relaxing;          //Active Cascade Work List (NULL: Idle)
+  static thread_local int maxdepth;                     //Deepest Cascade Work List (Reset by Caller)
+
   void updatefrequency(Layermap& map, ivec2 ipos){
     int ind = ipos.y*map.dim.x+ipos.x;
-    track[ind] += volume;
-  }
-
-  static void resetfrequency(Layermap& map){
-    for(int i = 0; i < map.dim.x*map.dim.y; i++)
-      track[i] = 0.0f;
+    atomically(track[ind], [&](float t){
+      return t + volume;
+    });
   }
 
-  static void mapfrequency(Layermap& map){
+  //Fused Pass: Relax Frequency, Reset Track, Write Texture (Optional)
+  static void mapfrequency(Layermap& map, uint32_t* texture = NULL){
     const float lrate = 0.01f;
     const float K = 50.0f;
 //    const float lrate = 0.05f;
 //    const float K = 15.0f;
-    for(int i = 0; i < map.dim.x*map.dim.y; i++)
-      frequency[i] = (1.0f-lrate)*frequency[i] + lrate*K*track[i]/(1.0f + K*track[i]);;
+    const int N = map.dim.x*map.dim.y;
+
+    if(texture == NULL){
+      #pragma omp parallel for simd
+      for(int i = 0; i < N; i++){
+        frequency[i] = (1.0f-lrate)*frequency[i] + lrate*K*track[i]/(1.0f + K*track[i]);
+        track[i] = 0.0f;
+      }
+      return;
+    }
+
+    #pragma omp parallel for simd
+    for(int i = 0; i < N; i++){
+      frequency[i] = (1.0f-lrate)*frequency[i] + lrate*K*track[i]/(1.0f + K*track[i]);
+      track[i] = 0.0f;
+      texture[i] = texel(frequency[i]);
+    }
   }
 
 
@@ -371,3 +560,6 @@ double WaterParticle::volumeFactor = 0.015;
 
 float* WaterParticle::frequency = NULL;//new float[SIZEX*SIZEY]{0.0f};
 float* WaterParticle::track = NULL;//new float[SIZEX*SIZEY]{0.0f};
+thread_local vector<WaterParticle>* WaterParticle::spawned = NULL;
+thread_local vector<WaterParticle::Relax>* WaterParticle::relaxing = NULL;
+thread_local int WaterParticle::maxdepth = 0;
@@ -10,14 +10,13 @@ using namespace glm;
 
 struct WindParticle : public Particle {
 
-  WindParticle(Layermap& map){
+  WindParticle(Layermap& map, uint64_t cycle, uint64_t i){
 
-    pos = vec2(rand()%map.dim.x, rand()%map.dim.y);
+    pos = spawn(map.dim, WINDSPAWN, cycle, i);
 
     ipos = round(pos);
     surface = map.surface(ipos);
-    param = soils[surface];
-    contains = param.transports;    //The Transporting Type
+    contains = surf.transports[surface];  //The Transporting Type
 
   }
 
@@ -37,7 +36,6 @@ struct WindParticle : public Particle {
   vec3 n;
   SurfType surface;
   SurfType contains;
-  SurfParam param;
 
   const double gravity = 0.25;
   const double winddominance = 0.2;
@@ -46,21 +44,27 @@ struct WindParticle : public Particle {
 
 
   static float* frequency;
+  static void maptexture(Layermap& map, uint32_t* texture){
+    #pragma omp parallel for simd
+    for(int i = 0; i < map.dim.x*map.dim.y; i++)
+      texture[i] = texel(frequency[i]);
+  }
   void updatefrequency(Layermap& map, ivec2 ipos){
     int ind = ipos.y*map.dim.x+ipos.x;
-    frequency[ind] = 0.5*frequency[ind] + 0.5f;
+    atomically(frequency[ind], [](float f){
+      return 0.5f*f + 0.5f;
+    });
   }
 
-  bool move(Layermap& map, Vertexpool<Vertex>& vertexpool){
+  bool move(Layermap& map){
 
-    if(soils[contains].suspension == 0.0)
+    if(!surf.wind || surf.suspension[contains] == 0.0)
       return false;
 
     //Integer Position
     ipos = round(pos);
     n = map.normal(ipos);
     surface = map.surface(ipos);
-    param = soils[surface];
     updatefrequency(map, ipos);
 
     //Surface Height, No-Clip Condition
@@ -91,9 +95,9 @@ struct WindParticle : public Particle {
 
   }
 
-  bool interact(Layermap& map, Vertexpool<Vertex>& vertexpool){
+  bool interact(Layermap& map){
 
-  //  if(param.abrasion == 0.0)
+  //  if(surf.abrasion[surface] == 0.0)
   //    return true;
 
     ivec2 npos = round(pos);
@@ -102,32 +106,31 @@ struct WindParticle : public Particle {
     if(height <= map.height(pos)*(float)SCALE/80.0f){
 
       //If this surface can conribute to this particle
-      if(param.transports == contains){
+      if(surf.transports[surface] == contains){
 
         double force = length(speed)*(map.height(npos)-height)*(float)SCALE/80.0f*(1.0f-sediment);
 
-        double diff = map.remove(ipos, param.suspension*force);
-        sediment += (param.suspension*force - diff);
+        const float suspension = surf.suspension[surface];
+        double diff = map.remove(ipos, suspension*force);
+        sediment += (suspension*force - diff);
 
-        Particle::cascade(ipos, map, vertexpool, 1);
-        map.update(ipos, vertexpool);
+        Particle::cascade(ipos, map, 1);
 
       }
 
     }
 
-    else if(param.suspension > 0.0){
+    else if(surf.suspension[surface] > 0.0){
 
-      sediment -= soils[contains].suspension*sediment;
+      const float suspension = surf.suspension[contains];
+      sediment -= suspension*sediment;
 
-      map.add(npos, map.pool.get(0.5f*soils[contains].suspension*sediment, contains));
-      map.add(ipos, map.pool.get(0.5f*soils[contains].suspension*sediment, contains));
+      map.add(npos, map.pool.get(0.5f*suspension*sediment, contains));
+      map.add(ipos, map.pool.get(0.5f*suspension*sediment, contains));
 
-      Particle::cascade(ipos, map, vertexpool, 1);
-      map.update(ipos, vertexpool);
+      Particle::cascade(ipos, map, 1);
 
-      Particle::cascade(npos, map, vertexpool, 1);
-      map.update(npos, vertexpool);
+      Particle::cascade(npos, map, 1);
 
     }
 
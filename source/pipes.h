@@ -0,0 +1,145 @@
+/*
+================================================================================
+            Virtual Pipes Shallow-Water Solver for Standing Water
+================================================================================
+
+Standing water is the top Air section of a column. Instead of relaxing it cell
+by cell with WaterParticle::cascade, the solver moves it in bulk: every cell is
+connected to its four neighbors by virtual pipes, whose outflow fluxes are
+accelerated by the difference of the water surface heights (ground + water).
+Outflows are scaled so that no cell drains more water than it holds, and damped
+so that lakes settle instead of sloshing. Particles still erode the channels.
+
+Both passes of a step only write to their own cell and read the neighbors from
+the previous pass, so they run in parallel. Water heights are double-buffered.
+The map is read into the dense arrays once per cycle, and only cells whose
+water changed are written back.
+
+*/
+
+namespace pipes {
+
+bool ENABLED = false;           //Replace the Lateral Water Cascade of Seep
+int STEPS = 16;                 //Solver Steps per Cycle
+const double PIPE = 0.2;        //Flux Gain per Height Difference (at SCALE 80)
+const double MAXGAIN = 0.24;    //Largest Scaled Gain (Stable < 0.25)
+const double DAMPING = 0.95;    //Flux Retained per Step
+
+ivec2 dim = ivec2(0);
+double* ground = NULL;          //Height below the Water
+double* water = NULL;           //Water Height
+double* next = NULL;            //Water Height (Back Buffer)
+double* flux = NULL;            //Outflow Flux (-x, +x, -y, +y per Cell)
+
+void init(Layermap& map){
+
+  if(dim == map.dim)
+    return;
+
+  delete[] ground;
+  delete[] water;
+  delete[] next;
+  delete[] flux;
+
+  dim = map.dim;
+  ground = new double[dim.x*dim.y]{0.0};
+  water = new double[dim.x*dim.y]{0.0};
+  next = new double[dim.x*dim.y]{0.0};
+  flux = new double[4*dim.x*dim.y]{0.0};
+
+}
+
+//Drop the Fluxes of the Previous Map (Re-Initialization)
+void reset(){
+  for(int i = 0; i < 4*dim.x*dim.y; i++)
+    flux[i] = 0.0;
+}
+
+void read(Layermap& map){
+
+  const double* H = map.heightmap();
+
+  #pragma omp parallel for
+  for(int x = 0; x < dim.x; x++)
+  for(int y = 0; y < dim.y; y++){
+    const int i = x*dim.y+y;
+    water[i] = map.standing(ivec2(x, y));
+    ground[i] = H[i] - water[i];
+  }
+
+}
+
+void step(){
+
+  const int X = dim.x;
+  const int Y = dim.y;
+  const double gain = std::min(PIPE*(double)SCALE/80.0, MAXGAIN);
+
+  //Outflow Fluxes
+  #pragma omp parallel for
+  for(int x = 0; x < X; x++)
+  for(int y = 0; y < Y; y++){
+
+    const int i = x*Y+y;
+    const double h = ground[i] + water[i];
+    const int n[4] = { i-Y, i+Y, i-1, i+1 };
+    const bool in[4] = { x > 0, x < X-1, y > 0, y < Y-1 };
+
+    double out[4], total = 0.0;
+    for(int d = 0; d < 4; d++){
+      out[d] = 0.0;
+      if(in[d]) out[d] = std::max(0.0, DAMPING*flux[4*i+d] + gain*(h - ground[n[d]] - water[n[d]]));
+      total += out[d];
+    }
+
+    //No Cell Drains more than it Holds
+    const double k = (total > water[i]) ? water[i]/total : 1.0;
+    for(int d = 0; d < 4; d++)
+      flux[4*i+d] = k*out[d];
+
+  }
+
+  //Water Heights (Outflow, Inflow from the Opposite Pipe of the Neighbor)
+  #pragma omp parallel for
+  for(int x = 0; x < X; x++)
+  for(int y = 0; y < Y; y++){
+    const int i = x*Y+y;
+    const double* f = &flux[4*i];
+    double w = water[i] - f[0] - f[1] - f[2] - f[3];
+    if(x > 0)   w += flux[4*(i-Y)+1];
+    if(x < X-1) w += flux[4*(i+Y)+0];
+    if(y > 0)   w += flux[4*(i-1)+3];
+    if(y < Y-1) w += flux[4*(i+1)+2];
+    next[i] = std::max(0.0, w);
+  }
+
+  std::swap(water, next);
+
+}
+
+void write(Layermap& map){
+
+  //Rows of one Residue (mod 3) Touch Disjoint Normals
+  for(int r = 0; r < 3; r++){
+
+    #pragma omp parallel for
+    for(int x = r; x < dim.x; x += 3)
+    for(int y = 0; y < dim.y; y++)
+      map.standing(ivec2(x, y), water[x*dim.y+y]);
+
+  }
+
+}
+
+//Move Standing Water for STEPS Steps
+void solve(Layermap& map){
+
+  init(map);
+  read(map);
+  for(int s = 0; s < STEPS; s++)
+    step();
+  write(map);
+
+}
+
+}
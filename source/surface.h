@@ -56,6 +56,127 @@ map<string, int> soilmap = {
 
 };
 
+/*
+================================================================================
+                  Hot Parameter Table (Structure of Arrays)
+================================================================================
+
+Particle steps read a handful of parameters of the surface below them. Copying
+a SurfParam out of soils also copies its name, so the fields used by the
+particles are mirrored into flat arrays indexed by SurfType, without the name
+and color metadata. Call build() whenever soils changes.
+
+The process flags let the kernels skip work a profile can never do, e.g. wind
+when no soil has a suspension rate. With SOILMACHINE_FROZEN, the table is a
+constexpr profile generated from a .soil file (soilmachine-headless -freeze),
+so the flags and the number of soil types are compile-time constants.
+
+*/
+
+#ifdef SOILMACHINE_FROZEN
+
+#include "frozen.h"               //Generated Profile (frozen::SurfProfile)
+
+struct SurfTable : frozen::SurfProfile {
+
+  //Loaded Profile must Match the Frozen Profile
+  void build(){
+
+    bool match = (soils.size() == N) && (soilmap["Air"] == air);
+    for(size_t t = 0; t < soils.size() && match; t++){
+      const SurfParam& s = soils[t];
+      match = density[t] == s.density && porosity[t] == s.porosity
+        && transports[t] == s.transports && solubility[t] == s.solubility
+        && equrate[t] == s.equrate && friction[t] == s.friction
+        && erodes[t] == s.erodes && erosionrate[t] == s.erosionrate
+        && cascades[t] == s.cascades && maxdiff[t] == s.maxdiff
+        && settling[t] == s.settling && abrades[t] == s.abrades
+        && suspension[t] == s.suspension && abrasion[t] == s.abrasion
+        && suspendable[t] == (soils[s.transports].suspension > 0.0f);
+    }
+
+    if(!match){
+      cout<<"Error: Soil profile does not match the frozen profile "<<profile<<endl;
+      exit(0);
+    }
+
+  }
+
+} surf;
+
+#else
+
+struct SurfTable {
+
+  SurfType air = 0;               //Surface Type of Water
+
+  bool wind = true;               //Any Soil is Suspended by Wind
+  bool seeping = true;            //Any Soil (Except Water) is Porous
+  bool cascading = true;          //Any Soil Settles
+  bool converting = true;         //Any Soil Erodes to a Different Type
+
+  vector<float> density;
+  vector<float> porosity;
+
+  vector<SurfType> transports;
+  vector<float> solubility;
+  vector<float> equrate;
+  vector<float> friction;
+
+  vector<SurfType> erodes;
+  vector<float> erosionrate;
+
+  vector<SurfType> cascades;
+  vector<float> maxdiff;
+  vector<float> settling;
+
+  vector<SurfType> abrades;
+  vector<float> suspension;
+  vector<float> abrasion;
+  vector<bool> suspendable;       //Transported as a Suspended Type (Wind Moves)
+
+  void build(){
+
+    const size_t N = soils.size();
+    density.resize(N);      porosity.resize(N);
+    transports.resize(N);   solubility.resize(N);
+    equrate.resize(N);      friction.resize(N);
+    erodes.resize(N);       erosionrate.resize(N);
+    cascades.resize(N);     maxdiff.resize(N);
+    settling.resize(N);     abrades.resize(N);
+    suspension.resize(N);   abrasion.resize(N);
+    suspendable.resize(N);
+
+    for(size_t t = 0; t < N; t++){
+      const SurfParam& s = soils[t];
+      density[t] = s.density;       porosity[t] = s.porosity;
+      transports[t] = s.transports; solubility[t] = s.solubility;
+      equrate[t] = s.equrate;       friction[t] = s.friction;
+      erodes[t] = s.erodes;         erosionrate[t] = s.erosionrate;
+      cascades[t] = s.cascades;     maxdiff[t] = s.maxdiff;
+      settling[t] = s.settling;     abrades[t] = s.abrades;
+      suspension[t] = s.suspension; abrasion[t] = s.abrasion;
+    }
+
+    for(size_t t = 0; t < N; t++)
+      suspendable[t] = (suspension[transports[t]] > 0.0f);
+
+    air = soilmap["Air"];
+
+    wind = seeping = cascading = converting = false;
+    for(size_t t = 0; t < N; t++){
+      wind = wind || (suspension[t] > 0.0f);
+      seeping = seeping || (t != air && porosity[t] > 0.0f);
+      cascading = cascading || (settling[t] > 0.0f);
+      converting = converting || (erodes[t] != t);
+    }
+
+  }
+
+} surf;
+
+#endif
+
 /*
 ================================================================================
                   Description of Noise Layers as a Struct